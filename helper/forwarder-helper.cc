@@ -84,8 +84,8 @@ ForwarderHelper::InstallPriv (Ptr<Node> node) const
           Ptr<LoraNetDevice> loraNetDevice =
             currentNetDevice->GetObject<LoraNetDevice> ();
           app->SetLoraNetDevice (loraNetDevice);
-          loraNetDevice->SetReceiveCallback (MakeCallback
-                                               (&Forwarder::ReceiveFromLora, app));
+          loraNetDevice->SetLoraReceiveCallback (MakeCallback
+                                                   (&Forwarder::ReceiveFromLora, app));
         }
       else if (currentNetDevice->GetObject<PointToPointNetDevice> () != 0)
         {
@@ -24,6 +24,7 @@
 #include "ns3/log.h"
 #include "ns3/simulator.h"
 #include "ns3/lorawan-mac-header.h"
+#include "ns3/abort.h"
 #include <algorithm>
 #include <bits/stdint-uintn.h>
 #include <cmath>
@@ -37,7 +38,13 @@ namespace ns3 {
 namespace lorawan {
 NS_LOG_COMPONENT_DEFINE ("LoraPacketTracker");
 
-LoraPacketTracker::LoraPacketTracker ()
+// Rows are pushed by reference, so the constant needs a definition
+const uint32_t LoraPacketTracker::NO_ROW;
+
+LoraPacketTracker::LoraPacketTracker () :
+  m_bucketWidth (Minutes (1)),
+  m_phySentBuckets (1),
+  m_macBuckets (2)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -47,6 +54,70 @@ LoraPacketTracker::~LoraPacketTracker ()
   NS_LOG_FUNCTION (this);
 }
 
+void
+LoraPacketTracker::SetBucketWidth (Time width)
+{
+  NS_LOG_FUNCTION (this << width);
+
+  NS_ABORT_MSG_UNLESS (m_phySendTime.empty () && m_macSendTime.empty (),
+                       "The bucket width can't change after packets were tracked");
+  NS_ABORT_MSG_UNLESS (width.IsStrictlyPositive (), "The bucket width must be positive");
+
+  m_bucketWidth = width;
+}
+
+LoraPacketTracker::BucketCounters::BucketCounters (uint32_t nCounters) :
+  m_nCounters (nCounters),
+  m_prefix (nCounters, 0),
+  m_validPrefixes (0)
+{
+}
+
+void
+LoraPacketTracker::BucketCounters::Add (uint64_t bucket, uint32_t counter,
+                                        int32_t value)
+{
+  if (m_counts.size () <= bucket * m_nCounters)
+    {
+      m_counts.resize ((bucket + 1) * m_nCounters, 0);
+    }
+  m_counts[bucket * m_nCounters + counter] += value;
+
+  // The sums of the following buckets are no longer valid
+  m_validPrefixes = std::min (m_validPrefixes, bucket);
+}
+
+uint64_t
+LoraPacketTracker::BucketCounters::Sum (uint64_t first, uint64_t last,
+                                        uint32_t counter)
+{
+  uint64_t nBuckets = m_counts.size () / m_nCounters;
+  last = std::min (last, nBuckets);
+  if (first >= last)
+    {
+      return 0;
+    }
+
+  // Bring the prefix sums up to date, starting from the first bucket that
+  // changed. Since outcomes arrive shortly after packets are sent, this only
+  // goes through the latest buckets.
+  if (m_validPrefixes < nBuckets)
+    {
+      m_prefix.resize ((nBuckets + 1) * m_nCounters);
+      for (uint64_t bucket = m_validPrefixes; bucket < nBuckets; bucket++)
+        {
+          for (uint32_t c = 0; c < m_nCounters; c++)
+            {
+              m_prefix[(bucket + 1) * m_nCounters + c] =
+                m_prefix[bucket * m_nCounters + c] + m_counts[bucket * m_nCounters + c];
+            }
+        }
+      m_validPrefixes = nBuckets;
+    }
+
+  return m_prefix[last * m_nCounters + counter] - m_prefix[first * m_nCounters + counter];
+}
+
 /////////////////
 // MAC metrics //
 /////////////////
@@ -58,13 +129,14 @@ LoraPacketTracker::MacTransmissionCallback (Ptr<Packet const> packet)
     {
       NS_LOG_INFO ("A new packet was sent by the MAC layer");
 
-      MacPacketStatus status;
-      status.packet = packet;
-      status.sendTime = Simulator::Now ();
-      status.senderId = Simulator::GetContext ();
-      status.receivedTime = Time::Max ();
-
-      m_macPacketTracker.insert (std::pair<Ptr<Packet const>, MacPacketStatus> (packet, status));
+      if (m_macRows.insert (std::make_pair (packet->GetUid (),
+                                            m_macSendTime.size ())).second)
+        {
+          m_macSendTime.push_back (Simulator::Now ());
+          m_macSenderId.push_back (Simulator::GetContext ());
+          m_macReceptions.push_back (0);
+          m_macBuckets.Add (GetBucket (Simulator::Now ()), 0, 1);
+        }
     }
 }
 
@@ -76,13 +148,13 @@ LoraPacketTracker::RequiredTransmissionsCallback (uint8_t reqTx, bool success, T
   NS_LOG_DEBUG ("Packet: " << packet << "ReqTx " << unsigned (reqTx) << ", succ: " << success
                            << ", firstAttempt: " << firstAttempt.GetSeconds ());
 
-  RetransmissionStatus entry;
-  entry.firstAttempt = firstAttempt;
-  entry.finishTime = Simulator::Now ();
-  entry.reTxAttempts = reqTx;
-  entry.successful = success;
-
-  m_reTransmissionTracker.insert (std::pair<Ptr<Packet>, RetransmissionStatus> (packet, entry));
+  if (m_reTxRows.insert (std::make_pair (packet->GetUid (),
+                                         m_reTxFirstAttempt.size ())).second)
+    {
+      m_reTxFirstAttempt.push_back (firstAttempt);
+      m_reTxAttempts.push_back (reqTx);
+      m_reTxSuccessful.push_back (success);
+    }
 }
 
 void
@@ -93,12 +165,16 @@ LoraPacketTracker::MacGwReceptionCallback (Ptr<Packet const> packet)
       NS_LOG_INFO ("A packet was successfully received"
                    << " at the MAC layer of gateway " << Simulator::GetContext ());
 
-      // Find the received packet in the m_macPacketTracker
-      auto it = m_macPacketTracker.find (packet);
-      if (it != m_macPacketTracker.end ())
+      // Find the received packet in the MAC packet rows
+      std::unordered_map<uint64_t, uint32_t>::const_iterator it =
+        m_macRows.find (packet->GetUid ());
+      if (it != m_macRows.end ())
         {
-          (*it).second.receptionTimes.insert (
-              std::pair<int, Time> (Simulator::GetContext (), Simulator::Now ()));
+          // The packet counts as received at its first reception
+          if (m_macReceptions[it->second]++ == 0)
+            {
+              m_macBuckets.Add (GetBucket (m_macSendTime[it->second]), 1, 1);
+            }
         }
       else
         {
@@ -119,15 +195,19 @@ LoraPacketTracker::TransmissionCallback (Ptr<Packet const> packet, uint32_t edId
       NS_LOG_INFO ("PHY packet " << packet
                                  << " was transmitted by device "
                                  << edId);
-      // Create a packetStatus
-      PacketStatus status;
-      status.packet = packet;
-      status.sendTime = Simulator::Now ();
-      status.senderId = edId;
-      status.txSuccessful = true;
-
-      m_packetTracker.insert (std::pair<Ptr<Packet const>, PacketStatus> (packet, status));
-      NS_LOG_DEBUG ("Inserted PHY packet");
+
+      // Add a row for the packet, unless it is a retransmission of a packet
+      // that already has one
+      if (m_phyRows.insert (std::make_pair (packet->GetUid (),
+                                            m_phySendTime.size ())).second)
+        {
+          m_phySendTime.push_back (Simulator::Now ());
+          m_phySenderId.push_back (edId);
+          m_phyTxSuccessful.push_back (true);
+          m_phyFirstOutcome.push_back (NO_ROW);
+          m_phySentBuckets.Add (GetBucket (Simulator::Now ()), 0, 1);
+          NS_LOG_DEBUG ("Inserted PHY packet");
+        }
     }
 }
 
@@ -136,14 +216,11 @@ LoraPacketTracker::PacketReceptionCallback (Ptr<Packet const> packet, uint32_t g
 {
   if (IsUplink (packet))
     {
-      // Remove the successfully received packet from the list of sent ones
       NS_LOG_INFO ("PHY packet " << packet
                                  << " was successfully received at gateway "
                                  << gwId);
 
-      std::map<Ptr<Packet const>, PacketStatus>::iterator it = m_packetTracker.find (packet);
-      NS_LOG_DEBUG((*it).second.txSuccessful) ;
-      (*it).second.outcomes.insert (std::pair<int, enum PhyPacketOutcome> (gwId, RECEIVED));
+      AddPhyOutcome (packet, gwId, RECEIVED);
     }
 }
 
@@ -156,9 +233,7 @@ LoraPacketTracker::InterferenceCallback (Ptr<Packet const> packet, uint32_t gwId
                                  << " was interfered at gateway "
                                  << gwId);
 
-      std::map<Ptr<Packet const>, PacketStatus>::iterator it = m_packetTracker.find (packet);
-      (*it).second.outcomes.insert (std::pair<int, enum PhyPacketOutcome> (gwId,
-                                                                           INTERFERED));
+      AddPhyOutcome (packet, gwId, INTERFERED);
     }
 }
 
@@ -170,9 +245,8 @@ LoraPacketTracker::NoMoreReceiversCallback (Ptr<Packet const> packet, uint32_t g
       NS_LOG_INFO ("PHY packet " << packet
                                  << " was lost because no more receivers at gateway "
                                  << gwId);
-      std::map<Ptr<Packet const>, PacketStatus>::iterator it = m_packetTracker.find (packet);
-      (*it).second.outcomes.insert (std::pair<int, enum PhyPacketOutcome> (gwId,
-                                                                           NO_MORE_RECEIVERS));
+
+      AddPhyOutcome (packet, gwId, NO_MORE_RECEIVERS);
     }
 }
 
@@ -185,9 +259,7 @@ LoraPacketTracker::UnderSensitivityCallback (Ptr<Packet const> packet, uint32_t
                                  << " was lost because under sensitivity at gateway "
                                  << gwId);
 
-      std::map<Ptr<Packet const>, PacketStatus>::iterator it = m_packetTracker.find (packet);
-      (*it).second.outcomes.insert (std::pair<int, enum PhyPacketOutcome> (gwId,
-                                                                           UNDER_SENSITIVITY));
+      AddPhyOutcome (packet, gwId, UNDER_SENSITIVITY);
     }
 }
 
@@ -200,9 +272,7 @@ LoraPacketTracker::LostBecauseTxCallback (Ptr<Packet const> packet, uint32_t gwI
                                  << " was lost because of GW transmission at gateway "
                                  << gwId);
 
-      std::map<Ptr<Packet const>, PacketStatus>::iterator it = m_packetTracker.find (packet);
-      (*it).second.outcomes.insert (std::pair<int, enum PhyPacketOutcome> (gwId,
-                                                                           LOST_BECAUSE_TX));
+      AddPhyOutcome (packet, gwId, LOST_BECAUSE_TX);
     }
 }
 
@@ -213,22 +283,204 @@ LoraPacketTracker::InterruptedTransmissionCallback (Ptr<Packet const> packet)
     {
       NS_LOG_INFO ("PHY packet " << packet << " interrupted");
 
-      std::map<Ptr<Packet const>, PacketStatus>::iterator it = m_packetTracker.find (packet);
-      (*it).second.txSuccessful = false;
+      uint32_t row = GetPhyRow (packet);
+      if (row != NO_ROW && m_phyTxSuccessful[row])
+        {
+          m_phyTxSuccessful[row] = false;
+
+          // Interrupted packets are not counted, and neither are their
+          // outcomes
+          uint64_t bucket = GetBucket (m_phySendTime[row]);
+          m_phySentBuckets.Add (bucket, 0, -1);
+          for (uint32_t outcome = m_phyFirstOutcome[row]; outcome != NO_ROW;
+               outcome = m_outcomeNext[outcome])
+            {
+              GetGwBuckets (m_outcomeGwId[outcome]).Add (bucket, m_outcome[outcome], -1);
+            }
+        }
     }
 }
 
 bool
-LoraPacketTracker::IsUplink (Ptr<Packet const> packet)
+LoraPacketTracker::IsUplink (Ptr<Packet const> packet) const
 {
   NS_LOG_FUNCTION (this);
 
+  // The direction is in the first byte of the packet: peek it without copying
+  // the packet
   LorawanMacHeader mHdr;
-  Ptr<Packet> copy = packet->Copy ();
-  copy->RemoveHeader (mHdr);
+  packet->PeekHeader (mHdr);
   return mHdr.IsUplink ();
 }
 
+uint32_t
+LoraPacketTracker::GetPhyRow (Ptr<Packet const> packet) const
+{
+  std::unordered_map<uint64_t, uint32_t>::const_iterator it =
+    m_phyRows.find (packet->GetUid ());
+  if (it == m_phyRows.end ())
+    {
+      NS_LOG_DEBUG ("PHY packet " << packet << " is not tracked");
+      return NO_ROW;
+    }
+  return it->second;
+}
+
+void
+LoraPacketTracker::AddPhyOutcome (Ptr<Packet const> packet, uint32_t gwId,
+                                  enum PhyPacketOutcome outcome)
+{
+  uint32_t row = GetPhyRow (packet);
+  if (row == NO_ROW)
+    {
+      return;
+    }
+
+  // Walk the outcomes of the packet: only the first one of each gateway is
+  // kept
+  uint32_t *link = &m_phyFirstOutcome[row];
+  while (*link != NO_ROW)
+    {
+      if (m_outcomeGwId[*link] == gwId)
+        {
+          return;
+        }
+      link = &m_outcomeNext[*link];
+    }
+
+  *link = m_outcome.size ();
+  m_outcomePhyRow.push_back (row);
+  m_outcomeGwId.push_back (gwId);
+  m_outcome.push_back (outcome);
+  m_outcomeNext.push_back (NO_ROW);
+
+  if (m_phyTxSuccessful[row])
+    {
+      GetGwBuckets (gwId).Add (GetBucket (m_phySendTime[row]), outcome, 1);
+    }
+}
+
+LoraPacketTracker::BucketCounters &
+LoraPacketTracker::GetGwBuckets (uint32_t gwId)
+{
+  std::pair<std::unordered_map<uint32_t, uint32_t>::iterator, bool> it =
+    m_gwIndex.insert (std::make_pair (gwId, m_gwBuckets.size ()));
+  if (it.second)
+    {
+      m_gwBuckets.push_back (BucketCounters (UNSET));
+    }
+  return m_gwBuckets[it.first->second];
+}
+
+uint64_t
+LoraPacketTracker::GetBucket (Time time) const
+{
+  return time.IsStrictlyNegative () ? 0 :
+    time.GetTimeStep () / m_bucketWidth.GetTimeStep ();
+}
+
+bool
+LoraPacketTracker::GetBuckets (Time startTime, Time stopTime, uint64_t &first,
+                               uint64_t &last) const
+{
+  if (startTime.IsStrictlyNegative ())
+    {
+      startTime = Seconds (0);
+    }
+  if (stopTime < startTime)
+    {
+      return false;
+    }
+
+  int64_t width = m_bucketWidth.GetTimeStep ();
+  first = (startTime.GetTimeStep () + width - 1) / width;
+  last = stopTime.GetTimeStep () / width;
+  return first < last;
+}
+
+void
+LoraPacketTracker::CountPhyRows (uint32_t first, uint32_t last, uint32_t gwId,
+                                 std::vector<int> &packetCounts) const
+{
+  for (uint32_t row = first; row < last; row++)
+    {
+      if (!m_phyTxSuccessful[row])
+        {
+          NS_LOG_DEBUG ("This packet transmission was interrupted at the PHY level");
+          // Do nothing and go to next packet
+          continue;
+        }
+
+      packetCounts.at (0)++;
+
+      switch (GetPhyOutcome (row, gwId))
+        {
+          case RECEIVED: {
+            packetCounts.at (1)++;
+            break;
+          }
+          case INTERFERED: {
+            packetCounts.at (2)++;
+            break;
+          }
+          case NO_MORE_RECEIVERS: {
+            packetCounts.at (3)++;
+            break;
+          }
+          case UNDER_SENSITIVITY: {
+            packetCounts.at (4)++;
+            break;
+          }
+          case LOST_BECAUSE_TX: {
+            packetCounts.at (5)++;
+            break;
+          }
+          case UNSET: {
+            break;
+          }
+        }
+    }
+}
+
+void
+LoraPacketTracker::CountMacRows (uint32_t first, uint32_t last, double &sent,
+                                 double &received) const
+{
+  for (uint32_t row = first; row < last; row++)
+    {
+      sent++;
+      if (m_macReceptions[row])
+        {
+          received++;
+        }
+    }
+}
+
+enum PhyPacketOutcome
+LoraPacketTracker::GetPhyOutcome (uint32_t row, uint32_t gwId) const
+{
+  for (uint32_t outcome = m_phyFirstOutcome[row]; outcome != NO_ROW;
+       outcome = m_outcomeNext[outcome])
+    {
+      if (m_outcomeGwId[outcome] == gwId)
+        {
+          return static_cast<enum PhyPacketOutcome> (m_outcome[outcome]);
+        }
+    }
+  return UNSET;
+}
+
+void
+LoraPacketTracker::GetRows (const std::vector<Time> &sendTimes, Time startTime,
+                            Time stopTime, uint32_t &first, uint32_t &last)
+{
+  first = std::lower_bound (sendTimes.begin (), sendTimes.end (), startTime) -
+    sendTimes.begin ();
+  last = std::upper_bound (sendTimes.begin (), sendTimes.end (), stopTime) -
+    sendTimes.begin ();
+  last = std::max (first, last);
+}
+
 ////////////////////////
 // Counting Functions //
 ////////////////////////
@@ -239,23 +491,21 @@ LoraPacketTracker::CountPhyPacketsPerEd (Time startTime, Time stopTime, uint edI
 {
   std::vector<int> packetCounts (3, 0);
 
-  for (auto itPhy = m_packetTracker.begin (); itPhy != m_packetTracker.end (); ++itPhy)
+  uint32_t first, last;
+  GetRows (m_phySendTime, startTime, stopTime, first, last);
+  for (uint32_t row = first; row < last; row++)
     {
-      if ((*itPhy).second.sendTime >= startTime && (*itPhy).second.sendTime <= stopTime)
+      if (m_phySenderId[row] == edId)
         {
-          // NS_LOG_DEBUG ("Dealing with packet " << (*itPhy).second.packet);
-          if ((*itPhy).second.senderId == edId)
+          packetCounts.at (0)++;
+          if (m_phyTxSuccessful[row])
             {
-              packetCounts.at (0)++;
-              if ((*itPhy).second.txSuccessful == true)
-                {
-                  packetCounts.at (1)++;
-                }
-              else
-                {
-                  packetCounts.at (2)++;
-                  NS_LOG_DEBUG ("This packet transmission was interrupted at the PHY level");
-                }
+              packetCounts.at (1)++;
+            }
+          else
+            {
+              packetCounts.at (2)++;
+              NS_LOG_DEBUG ("This packet transmission was interrupted at the PHY level");
             }
         }
     }
@@ -271,61 +521,38 @@ LoraPacketTracker::CountPhyPacketsPerGw (Time startTime, Time stopTime, int gwId
 
   std::vector<int> packetCounts (6, 0);
 
-  for (auto itPhy = m_packetTracker.begin ();
-       itPhy != m_packetTracker.end ();
-       ++itPhy)
+  uint32_t first, last;
+  uint64_t firstBucket, lastBucket;
+  if (!GetBuckets (startTime, stopTime, firstBucket, lastBucket))
     {
-      if ((*itPhy).second.sendTime >= startTime && (*itPhy).second.sendTime <= stopTime)
-        {
-          NS_LOG_DEBUG ("Dealing with packet " << (*itPhy).second.packet);
-          if ((*itPhy).second.txSuccessful == false)
-            {
-              NS_LOG_DEBUG ("This packet transmission was interrupted at the PHY level");
-              // Do nothing and go to next packet
-            }
-          else
-            {
-              packetCounts.at (0)++;
-
-              NS_LOG_DEBUG ("This packet was received by " <<
-                            (*itPhy).second.outcomes.size () << " gateways");
-
-              if ((*itPhy).second.outcomes.count (gwId) > 0)
-                {
-                  switch ((*itPhy).second.outcomes.at (gwId))
-                    {
-                      case RECEIVED: {
-                        packetCounts.at (1)++;
-                        break;
-                      }
-                      case INTERFERED: {
-                        packetCounts.at (2)++;
-                        break;
-                      }
-                      case NO_MORE_RECEIVERS: {
-                        packetCounts.at (3)++;
-                        break;
-                      }
-                      case UNDER_SENSITIVITY: {
-                        packetCounts.at (4)++;
-                        break;
-                      }
-                      case LOST_BECAUSE_TX: {
-                        packetCounts.at (5)++;
-                        break;
-                      }
-                      case UNSET: {
-                        break;
-                      }
-                    }
-                }
-            }
+      GetRows (m_phySendTime, startTime, stopTime, first, last);
+      CountPhyRows (first, last, gwId, packetCounts);
+      return packetCounts;
+    }
 
-        } // time
-    } // iterator
+  // Whole buckets
+  packetCounts.at (0) += m_phySentBuckets.Sum (firstBucket, lastBucket, 0);
+  std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_gwIndex.find (gwId);
+  if (it != m_gwIndex.end ())
+    {
+      BucketCounters &gwBuckets = m_gwBuckets[it->second];
+      packetCounts.at (1) += gwBuckets.Sum (firstBucket, lastBucket, RECEIVED);
+      packetCounts.at (2) += gwBuckets.Sum (firstBucket, lastBucket, INTERFERED);
+      packetCounts.at (3) += gwBuckets.Sum (firstBucket, lastBucket, NO_MORE_RECEIVERS);
+      packetCounts.at (4) += gwBuckets.Sum (firstBucket, lastBucket, UNDER_SENSITIVITY);
+      packetCounts.at (5) += gwBuckets.Sum (firstBucket, lastBucket, LOST_BECAUSE_TX);
+    }
+
+  // Rows before the first bucket and after the last one
+  int64_t width = m_bucketWidth.GetTimeStep ();
+  GetRows (m_phySendTime, startTime, TimeStep (firstBucket * width - 1), first, last);
+  CountPhyRows (first, last, gwId, packetCounts);
+  GetRows (m_phySendTime, TimeStep (lastBucket * width), stopTime, first, last);
+  CountPhyRows (first, last, gwId, packetCounts);
 
   return packetCounts;
 }
+
 std::string
 LoraPacketTracker::PrintPhyPacketsPerGw (Time startTime, Time stopTime,
                                          int gwId)
@@ -350,17 +577,16 @@ LoraPacketTracker::CountMacPacketsPerEd (Time startTime, Time stopTime, uint32_t
   NS_LOG_FUNCTION (this << startTime << stopTime);
 
   std::vector<uint> v (2, 0);
-  for (auto it = m_macPacketTracker.begin (); it != m_macPacketTracker.end (); ++it)
+  uint32_t first, last;
+  GetRows (m_macSendTime, startTime, stopTime, first, last);
+  for (uint32_t row = first; row < last; row++)
     {
-      if ((*it).second.sendTime >= startTime && (*it).second.sendTime <= stopTime)
+      if (m_macSenderId[row] == edId)
         {
-          if ((*it).second.senderId == edId)
+          v.at (0)++;
+          if (m_macReceptions[row])
             {
-              v.at (0)++;
-              if ((*it).second.receptionTimes.size ())
-                {
-                  v.at (1)++;
-                }
+              v.at (1)++;
             }
         }
     }
@@ -375,18 +601,26 @@ LoraPacketTracker::CountMacPacketsPerEd (Time startTime, Time stopTime, uint32_t
 
     double sent = 0;
     double received = 0;
-    for (auto it = m_macPacketTracker.begin ();
-         it != m_macPacketTracker.end ();
-         ++it)
+    uint32_t first, last;
+    uint64_t firstBucket, lastBucket;
+    if (!GetBuckets (startTime, stopTime, firstBucket, lastBucket))
       {
-        if ((*it).second.sendTime >= startTime && (*it).second.sendTime <= stopTime)
-          {
-            sent++;
-            if ((*it).second.receptionTimes.size ())
-              {
-                received++;
-              }
-          }
+        GetRows (m_macSendTime, startTime, stopTime, first, last);
+        CountMacRows (first, last, sent, received);
+      }
+    else
+      {
+        // Whole buckets, then the rows before the first bucket and after the
+        // last one
+        sent += m_macBuckets.Sum (firstBucket, lastBucket, 0);
+        received += m_macBuckets.Sum (firstBucket, lastBucket, 1);
+
+        int64_t width = m_bucketWidth.GetTimeStep ();
+        GetRows (m_macSendTime, startTime, TimeStep (firstBucket * width - 1),
+                 first, last);
+        CountMacRows (first, last, sent, received);
+        GetRows (m_macSendTime, TimeStep (lastBucket * width), stopTime, first, last);
+        CountMacRows (first, last, sent, received);
       }
 
     return std::to_string (sent) + " " +
@@ -398,19 +632,19 @@ LoraPacketTracker::CountMacPacketsPerEd (Time startTime, Time stopTime, uint32_t
   {
     NS_LOG_FUNCTION (this << startTime << stopTime);
 
+    // Rows are added when the procedure ends, so they are not sorted by the
+    // time of the first attempt
     double sent = 0;
     double received = 0;
-    for (auto it = m_reTransmissionTracker.begin ();
-         it != m_reTransmissionTracker.end ();
-         ++it)
+    for (uint32_t row = 0; row < m_reTxFirstAttempt.size (); row++)
       {
-        if ((*it).second.firstAttempt >= startTime && (*it).second.firstAttempt <= stopTime)
+        if (m_reTxFirstAttempt[row] >= startTime && m_reTxFirstAttempt[row] <= stopTime)
           {
             sent++;
             NS_LOG_DEBUG ("Found a packet");
-            NS_LOG_DEBUG ("Number of attempts: " << unsigned(it->second.reTxAttempts) <<
-                          ", successful: " << it->second.successful);
-            if (it->second.successful)
+            NS_LOG_DEBUG ("Number of attempts: " << unsigned(m_reTxAttempts[row]) <<
+                          ", successful: " << unsigned(m_reTxSuccessful[row]));
+            if (m_reTxSuccessful[row])
               {
                 received++;
               }
@@ -434,20 +668,18 @@ LoraPacketTracker::TxTimeStatisticsPerEd (Time startTime, Time stopTime,
   double meanTxInterval = 0;
   double tmpVariance = 0;
 
-  for (auto itPhy = m_packetTracker.begin (); itPhy != m_packetTracker.end (); ++itPhy)
+  uint32_t first, last;
+  GetRows (m_phySendTime, startTime, stopTime, first, last);
+  for (uint32_t row = first; row < last; row++)
     {
-      if ((*itPhy).second.sendTime >= startTime && (*itPhy).second.sendTime <= stopTime)
+      if (m_phySenderId[row] == edId)
         {
-          if ((*itPhy).second.senderId == edId)
-            {
-              outputTx.at (0)++;
+          outputTx.at (0)++;
 
-              NS_LOG_DEBUG ("Dealing with packet " << (*itPhy).second.packet);
-              NS_LOG_DEBUG ("This packet was sent at time "
-                            << (*itPhy).second.sendTime.GetSeconds ());
+          NS_LOG_DEBUG ("This packet was sent at time "
+                        << m_phySendTime[row].GetSeconds ());
 
-              txTime.push_back ((*itPhy).second.sendTime.GetSeconds ());
-            }
+          txTime.push_back (m_phySendTime[row].GetSeconds ());
         }
     }
   std::sort (txTime.begin (), txTime.end ());
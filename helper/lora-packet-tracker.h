@@ -26,8 +26,9 @@
 #include "ns3/nstime.h"
 
 #include <bits/stdint-uintn.h>
-#include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3 {
 namespace lorawan {
@@ -42,42 +43,37 @@ enum PhyPacketOutcome
   UNSET
 };
 
-struct PacketStatus
-{
-  Ptr<Packet const> packet;
-  uint32_t senderId;
-  Time sendTime;
-  std::map<int, enum PhyPacketOutcome> outcomes;
-  bool txSuccessful;
-};
-
-struct MacPacketStatus
-{
-  Ptr<Packet const> packet;
-  uint32_t senderId;
-  Time sendTime;
-  Time receivedTime;
-  std::map<int, Time> receptionTimes;
-};
-
-struct RetransmissionStatus
-{
-  Time firstAttempt;
-  Time finishTime;
-  uint8_t reTxAttempts;
-  bool successful;
-};
-
-typedef std::map<Ptr<Packet const>, MacPacketStatus> MacPacketData;
-typedef std::map<Ptr<Packet const>, PacketStatus> PhyPacketData;
-typedef std::map<Ptr<Packet const>, RetransmissionStatus> RetransmissionData;
-
+/**
+ * Class keeping track of the packets that are sent in the network, and of
+ * their outcomes at the PHY and MAC layers of the gateways.
+ *
+ * Data is stored in columns: each packet is a row of a set of arrays, and is
+ * found through a hash on its uid. The outcomes of PHY packets at each gateway
+ * are rows of a separate table, that are linked to the row of their packet.
+ * Since packets are recorded when they are sent, rows are sorted by send time,
+ * and counting functions only visit the rows inside their time interval.
+ *
+ * The network-wide counts, and the PHY counts of each gateway, are also kept
+ * in buckets of send time, updated as outcomes arrive. Counting functions sum
+ * the buckets that are fully inside their interval, and only visit the rows
+ * of the partially covered buckets at its edges. Printing the counts of a
+ * period that starts and ends at bucket boundaries thus doesn't depend on the
+ * number of tracked packets.
+ */
 class LoraPacketTracker
 {
 public:
   LoraPacketTracker ();
   ~LoraPacketTracker ();
 
+  /**
+   * Set the width of the send time buckets of the counters. This can only be
+   * done before any packet is tracked.
+   *
+   * \param width The width of a bucket (one minute by default).
+   */
+  void SetBucketWidth (Time width);
+
   /////////////////////////
   // PHY layer callbacks //
   /////////////////////////
@@ -104,7 +100,10 @@ public:
   ///////////////////////////////
   // Packet counting functions //
   ///////////////////////////////
-  bool IsUplink (Ptr<Packet const> packet);
+  /**
+   * Whether the packet is an uplink one, according to its MAC header.
+   */
+  bool IsUplink (Ptr<Packet const> packet) const;
 
   // void CountRetransmissions (Time transient, Time simulationTime, MacPacketData
   //                            macPacketTracker, RetransmissionData reTransmissionTracker,
@@ -182,9 +181,134 @@ public:
   std::vector<double> TxTimeStatisticsPerEd (Time startTime, Time endTime, uint32_t edId);
 
 private:
-  PhyPacketData m_packetTracker;
-  MacPacketData m_macPacketTracker;
-  RetransmissionData m_reTransmissionTracker;
+  /**
+   * Counters of events, in buckets of the send time of their packet. Sums
+   * over ranges of buckets use prefix sums, that are only recomputed from the
+   * first bucket that changed since the last sum.
+   */
+  class BucketCounters
+  {
+  public:
+    /**
+     * \param nCounters The number of counters in each bucket.
+     */
+    BucketCounters (uint32_t nCounters);
+
+    /**
+     * Add a value to a counter of a bucket.
+     */
+    void Add (uint64_t bucket, uint32_t counter, int32_t value);
+
+    /**
+     * Sum a counter over the buckets in [first, last).
+     */
+    uint64_t Sum (uint64_t first, uint64_t last, uint32_t counter);
+
+  private:
+    uint32_t m_nCounters;           //!< Number of counters in each bucket
+    std::vector<uint32_t> m_counts; //!< The counters of each bucket
+    std::vector<uint64_t> m_prefix; //!< Sums of the buckets before each one
+    uint64_t m_validPrefixes;       //!< Last bucket with an up to date sum
+  };
+
+  /**
+   * Get the bucket of a send time.
+   */
+  uint64_t GetBucket (Time time) const;
+
+  /**
+   * Get the buckets that are fully inside [startTime, stopTime].
+   *
+   * \param first Set to the first bucket in the interval.
+   * \param last Set to the bucket after the last one in the interval.
+   * \return Whether any bucket is fully inside the interval.
+   */
+  bool GetBuckets (Time startTime, Time stopTime, uint64_t &first,
+                   uint64_t &last) const;
+
+  /**
+   * Add the PHY counts of a gateway over a range of rows to packetCounts.
+   */
+  void CountPhyRows (uint32_t first, uint32_t last, uint32_t gwId,
+                     std::vector<int> &packetCounts) const;
+
+  /**
+   * Add the MAC counts over a range of rows to sent and received.
+   */
+  void CountMacRows (uint32_t first, uint32_t last, double &sent,
+                     double &received) const;
+
+  /**
+   * Get the bucket counters of a gateway, creating them if needed.
+   */
+  BucketCounters &GetGwBuckets (uint32_t gwId);
+
+  /**
+   * Get the range of rows whose send time is in [startTime, stopTime].
+   *
+   * \param sendTimes The send times of the rows, in non-decreasing order.
+   * \param startTime The start of the interval.
+   * \param stopTime The end of the interval.
+   * \param first Set to the first row in the interval.
+   * \param last Set to the row after the last one in the interval.
+   */
+  static void GetRows (const std::vector<Time> &sendTimes, Time startTime,
+                       Time stopTime, uint32_t &first, uint32_t &last);
+
+  /**
+   * Get the row of a PHY packet.
+   *
+   * \return The row, or NO_ROW if the packet is not tracked.
+   */
+  uint32_t GetPhyRow (Ptr<Packet const> packet) const;
+
+  /**
+   * Record the outcome of a PHY packet at a gateway. Only the first outcome at
+   * each gateway is kept.
+   */
+  void AddPhyOutcome (Ptr<Packet const> packet, uint32_t gwId,
+                      enum PhyPacketOutcome outcome);
+
+  /**
+   * Get the outcome of the PHY packet at a row at a gateway.
+   *
+   * \return The outcome, or UNSET if none was recorded.
+   */
+  enum PhyPacketOutcome GetPhyOutcome (uint32_t row, uint32_t gwId) const;
+
+  static const uint32_t NO_ROW = ~uint32_t (0); //!< Marks a missing row
+
+  // PHY packets, one row per packet
+  std::unordered_map<uint64_t, uint32_t> m_phyRows; //!< Row of each uid
+  std::vector<Time> m_phySendTime;         //!< Time the packet was sent
+  std::vector<uint32_t> m_phySenderId;     //!< Node that sent the packet
+  std::vector<uint8_t> m_phyTxSuccessful;  //!< Whether tx wasn't interrupted
+  std::vector<uint32_t> m_phyFirstOutcome; //!< First outcome row, or NO_ROW
+
+  // PHY outcomes, one row per packet and gateway
+  std::vector<uint32_t> m_outcomePhyRow;   //!< Row of the packet
+  std::vector<uint32_t> m_outcomeGwId;     //!< Gateway of the outcome
+  std::vector<uint8_t> m_outcome;          //!< The PhyPacketOutcome
+  std::vector<uint32_t> m_outcomeNext;     //!< Next row of the packet, or NO_ROW
+
+  // Counters bucketed by send time
+  Time m_bucketWidth;                      //!< Width of the buckets
+  BucketCounters m_phySentBuckets;         //!< Uninterrupted PHY packets
+  std::unordered_map<uint32_t, uint32_t> m_gwIndex; //!< Index of each gateway
+  std::vector<BucketCounters> m_gwBuckets; //!< PhyPacketOutcomes per gateway
+  BucketCounters m_macBuckets;             //!< MAC packets sent and received
+
+  // MAC packets, one row per packet
+  std::unordered_map<uint64_t, uint32_t> m_macRows; //!< Row of each uid
+  std::vector<Time> m_macSendTime;         //!< Time the packet was sent
+  std::vector<uint32_t> m_macSenderId;     //!< Node that sent the packet
+  std::vector<uint32_t> m_macReceptions;   //!< Receptions at gateway MACs
+
+  // Confirmed packets, one row per packet
+  std::unordered_map<uint64_t, uint32_t> m_reTxRows; //!< Row of each uid
+  std::vector<Time> m_reTxFirstAttempt;    //!< Time of the first attempt
+  std::vector<uint8_t> m_reTxAttempts;     //!< Transmissions that were used
+  std::vector<uint8_t> m_reTxSuccessful;   //!< Whether an ack was received
 };
 } // namespace lorawan
 } // namespace ns3
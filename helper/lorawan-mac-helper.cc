@@ -358,6 +358,18 @@ LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer
   NS_LOG_FUNCTION_NOARGS ();
 
   std::vector<int> sfQuantity (7, 0);
+
+  // Collect the gateway positions once, so that the power received by all
+  // gateways can be computed in a single batch for each device
+  std::vector<Ptr<MobilityModel> > gatewayPositions;
+  gatewayPositions.reserve (gateways.GetN ());
+  for (NodeContainer::Iterator currentGw = gateways.Begin (); currentGw != gateways.End ();
+       ++currentGw)
+    {
+      gatewayPositions.push_back ((*currentGw)->GetObject<MobilityModel> ());
+    }
+  std::vector<double> gatewayRxPowers;
+
   for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j)
     {
       Ptr<Node> object = *j;
@@ -369,25 +381,19 @@ LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer
       Ptr<ClassAEndDeviceLorawanMac> mac = loraNetDevice->GetMac ()->GetObject<ClassAEndDeviceLorawanMac> ();
       NS_ASSERT (mac != 0);
 
-      // Try computing the distance from each gateway and find the best one
-      Ptr<Node> bestGateway = gateways.Get (0);
-      Ptr<MobilityModel> bestGatewayPosition = bestGateway->GetObject<MobilityModel> ();
-
       // Assume devices transmit at 14 dBm
-      double highestRxPower = channel->GetRxPower (14, position, bestGatewayPosition);
+      channel->GetRxPowers (14, position, gatewayPositions, gatewayRxPowers);
 
-      for (NodeContainer::Iterator currentGw = gateways.Begin () + 1; currentGw != gateways.End ();
-           ++currentGw)
+      // Find the gateway the device is best received by
+      Ptr<Node> bestGateway = gateways.Get (0);
+      double highestRxPower = gatewayRxPowers[0];
+      for (uint32_t currentGw = 1; currentGw < gatewayRxPowers.size (); ++currentGw)
         {
-          // Compute the power received from the current gateway
-          Ptr<Node> curr = *currentGw;
-          Ptr<MobilityModel> currPosition = curr->GetObject<MobilityModel> ();
-          double currentRxPower = channel->GetRxPower (14, position, currPosition); // dBm
+          double currentRxPower = gatewayRxPowers[currentGw]; // dBm
 
           if (currentRxPower > highestRxPower)
             {
-              bestGateway = curr;
-              bestGatewayPosition = curr->GetObject<MobilityModel> ();
+              bestGateway = gateways.Get (currentGw);
               highestRxPower = currentRxPower;
             }
         }
@@ -79,11 +79,11 @@ AdrComponent::~AdrComponent ()
 {
 }
 
-void AdrComponent::OnReceivedPacket (Ptr<const Packet> packet,
+void AdrComponent::OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame,
                                      Ptr<EndDeviceStatus> status,
                                      Ptr<NetworkStatus> networkStatus)
 {
-  NS_LOG_FUNCTION (this->GetTypeId () << packet << networkStatus);
+  NS_LOG_FUNCTION (this->GetTypeId () << frame.packet << networkStatus);
 
   // We will only act just before reply, when all Gateways will have received
   // the packet, since we need their respective received power.
@@ -95,12 +95,7 @@ AdrComponent::BeforeSendingReply (Ptr<EndDeviceStatus> status,
 {
   NS_LOG_FUNCTION (this << status << networkStatus);
 
-  Ptr<Packet> myPacket = status->GetLastPacketReceivedFromDevice ()->Copy ();
-  LorawanMacHeader mHdr;
-  LoraFrameHeader fHdr;
-  fHdr.SetAsUplink ();
-  myPacket->RemoveHeader (mHdr);
-  myPacket->RemoveHeader (fHdr);
+  const LoraFrameHeader &fHdr = status->GetLastFrameHeaderReceivedFromDevice ();
 
   //Execute the ADR algotithm only if the request bit is set
   if (fHdr.GetAdr ())
@@ -51,7 +51,7 @@ public:
   //Destructor
   virtual ~AdrComponent ();
 
-  void OnReceivedPacket (Ptr<const Packet> packet,
+  void OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame,
                          Ptr<EndDeviceStatus> status,
                          Ptr<NetworkStatus> networkStatus);
 
@@ -19,6 +19,7 @@
 #include "ns3/building-penetration-loss.h"
 #include "ns3/mobility-building-info.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/log.h"
 #include <cmath>
 
@@ -36,11 +37,22 @@ BuildingPenetrationLoss::GetTypeId (void)
     .SetParent<PropagationLossModel> ()
     .SetGroupName ("Lora")
     .AddConstructor<BuildingPenetrationLoss> ()
+    .AddAttribute ("FixedPerLink",
+                   "Whether the loss of each link is drawn once and then "
+                   "kept fixed, instead of being drawn at each call. The "
+                   "indoor status and building of each node are then read "
+                   "the first time the node is used, so only nodes that do "
+                   "not move are supported.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BuildingPenetrationLoss::SetFixedPerLink,
+                                        &BuildingPenetrationLoss::IsFixedPerLink),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 
-BuildingPenetrationLoss::BuildingPenetrationLoss ()
+BuildingPenetrationLoss::BuildingPenetrationLoss () :
+  m_fixedPerLink (false)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -53,6 +65,22 @@ BuildingPenetrationLoss::~BuildingPenetrationLoss ()
   NS_LOG_FUNCTION_NOARGS ();
 }
 
+void
+BuildingPenetrationLoss::SetFixedPerLink (bool fixed)
+{
+  NS_LOG_FUNCTION (this << fixed);
+
+  m_fixedPerLink = fixed;
+  m_linkLosses.clear ();
+  m_indoorStatus.clear ();
+}
+
+bool
+BuildingPenetrationLoss::IsFixedPerLink (void) const
+{
+  return m_fixedPerLink;
+}
+
 double
 BuildingPenetrationLoss::DoCalcRxPower (double txPowerDbm,
                                         Ptr<MobilityModel> a,
@@ -60,9 +88,57 @@ BuildingPenetrationLoss::DoCalcRxPower (double txPowerDbm,
 {
   NS_LOG_FUNCTION (this << txPowerDbm << a << b);
 
+  if (m_fixedPerLink)
+    {
+      std::pair<std::unordered_map<std::pair<const MobilityModel *,
+                                             const MobilityModel *>,
+                                   LinkLoss, LinkHash>::iterator, bool> inserted =
+        m_linkLosses.insert (std::make_pair (std::make_pair (PeekPointer (a),
+                                                             PeekPointer (b)),
+                                             LinkLoss ()));
+      LinkLoss &link = inserted.first->second;
+      if (inserted.second)
+        {
+          link.a = a;
+          link.b = b;
+          link.loss = GetLoss (a, b, GetIndoorStatus (a), GetIndoorStatus (b));
+        }
+      else
+        {
+          NS_LOG_DEBUG ("Using the fixed loss of this link: " << link.loss);
+        }
+      return txPowerDbm - link.loss;
+    }
+
   Ptr<MobilityBuildingInfo> a1 = a->GetObject<MobilityBuildingInfo> ();
   Ptr<MobilityBuildingInfo> b1 = b->GetObject<MobilityBuildingInfo> ();
 
+  IndoorStatus aStatus = {a1->IsIndoor (), a1->GetBuilding ()};
+  IndoorStatus bStatus = {b1->IsIndoor (), b1->GetBuilding ()};
+
+  return txPowerDbm - GetLoss (a, b, aStatus, bStatus);
+}
+
+const BuildingPenetrationLoss::IndoorStatus &
+BuildingPenetrationLoss::GetIndoorStatus (Ptr<MobilityModel> mobility) const
+{
+  std::pair<std::unordered_map<const MobilityModel *, IndoorStatus>::iterator,
+            bool> inserted =
+    m_indoorStatus.insert (std::make_pair (PeekPointer (mobility), IndoorStatus ()));
+  if (inserted.second)
+    {
+      Ptr<MobilityBuildingInfo> info = mobility->GetObject<MobilityBuildingInfo> ();
+      inserted.first->second.indoor = info->IsIndoor ();
+      inserted.first->second.building = info->GetBuilding ();
+    }
+  return inserted.first->second;
+}
+
+double
+BuildingPenetrationLoss::GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b,
+                                  const IndoorStatus &aStatus,
+                                  const IndoorStatus &bStatus) const
+{
   // These are the components of the loss due to building penetration
   double externalWallLoss = 0;
   double tor1 = 0;
@@ -70,7 +146,7 @@ BuildingPenetrationLoss::DoCalcRxPower (double txPowerDbm,
   double gfh = 0;
 
   // Go through various cases in which a and b are indoors or outdoors
-  if ((b1->IsIndoor () && !a1->IsIndoor ()))
+  if ((bStatus.indoor && !aStatus.indoor))
     {
       NS_LOG_INFO ("Tx is outdoors and Rx is indoors");
 
@@ -80,7 +156,7 @@ BuildingPenetrationLoss::DoCalcRxPower (double txPowerDbm,
       gfh = 0;
 
     }
-  else if ((!b1->IsIndoor () && a1->IsIndoor ()))
+  else if ((!bStatus.indoor && aStatus.indoor))
     {
       NS_LOG_INFO ("Rx is outdoors and Tx is indoors");
 
@@ -91,14 +167,14 @@ BuildingPenetrationLoss::DoCalcRxPower (double txPowerDbm,
       gfh = 0;
 
     }
-  else if (!a1->IsIndoor ()&& !b1->IsIndoor ())
+  else if (!aStatus.indoor && !bStatus.indoor)
     {
       NS_LOG_DEBUG ("No penetration loss since both devices are outside");
     }
-  else if (a1->IsIndoor ()&& b1->IsIndoor ())
+  else if (aStatus.indoor && bStatus.indoor)
     {
       // They are in the same building
-      if (a1->GetBuilding () == b1->GetBuilding ())
+      if (aStatus.building == bStatus.building)
         {
           NS_LOG_INFO ("Devices are in the same building");
           // Only internal wall loss
@@ -127,7 +203,7 @@ BuildingPenetrationLoss::DoCalcRxPower (double txPowerDbm,
 
   NS_LOG_DEBUG ("Total loss due to building penetration: " << loss);
 
-  return txPowerDbm - loss;
+  return loss;
 }
 
 int64_t
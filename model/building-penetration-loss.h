@@ -23,6 +23,9 @@
 #include "ns3/mobility-model.h"
 #include "ns3/vector.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/building.h"
+#include <unordered_map>
+#include <utility>
 
 namespace ns3 {
 class MobilityModel;
@@ -41,7 +44,49 @@ public:
 
   ~BuildingPenetrationLoss ();
 
+  /**
+   * Set whether the loss of each link is drawn once and then kept fixed, as
+   * intended by TR 45.820, instead of being drawn again at each call.
+   *
+   * In this mode the indoor status and building of a node are read the first
+   * time the node is used and never updated, so only static nodes are
+   * supported: a node that moves keeps its original status on all its links.
+   */
+  void SetFixedPerLink (bool fixed);
+
+  /**
+   * Get whether the loss of each link is kept fixed.
+   */
+  bool IsFixedPerLink (void) const;
+
 private:
+  /**
+   * Whether a node is indoors, and in which building.
+   */
+  struct IndoorStatus
+  {
+    bool indoor;
+    Ptr<Building> building;
+  };
+
+  /**
+   * Compute the loss due to building penetration on a link.
+   *
+   * \param a The mobility model of the transmitter.
+   * \param b The mobility model of the receiver.
+   * \param aStatus Whether the transmitter is indoors.
+   * \param bStatus Whether the receiver is indoors.
+   * \returns The building penetration loss, in dB.
+   */
+  double GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b,
+                  const IndoorStatus &aStatus, const IndoorStatus &bStatus) const;
+
+  /**
+   * Get whether the node of a mobility model is indoors, looking it up in
+   * m_indoorStatus.
+   */
+  const IndoorStatus &GetIndoorStatus (Ptr<MobilityModel> mobility) const;
+
   /**
    * Perform the computation of the received power according to the current
    * model.
@@ -94,6 +139,48 @@ private:
    * loss.
    */
   mutable std::map<Ptr<MobilityModel>, int> m_wallLossMap;
+
+  /**
+   * Whether the loss of each link is kept fixed.
+   */
+  bool m_fixedPerLink;
+
+  /**
+   * The indoor status of each mobility model, used when m_fixedPerLink is
+   * set.
+   */
+  mutable std::unordered_map<const MobilityModel *, IndoorStatus> m_indoorStatus;
+
+  /**
+   * The fixed loss of a link, and the mobility models at its ends, which are
+   * kept alive so that their addresses are not reused.
+   */
+  struct LinkLoss
+  {
+    Ptr<MobilityModel> a;
+    Ptr<MobilityModel> b;
+    double loss;
+  };
+
+  /**
+   * Hash for a link, identified by the mobility models at its ends.
+   */
+  struct LinkHash
+  {
+    std::size_t operator() (const std::pair<const MobilityModel *,
+                                            const MobilityModel *> &link) const
+    {
+      return std::hash<const MobilityModel *> () (link.first) ^
+             (std::hash<const MobilityModel *> () (link.second) << 1);
+    }
+  };
+
+  /**
+   * The fixed loss of each link, used when m_fixedPerLink is set.
+   */
+  mutable std::unordered_map<std::pair<const MobilityModel *,
+                                       const MobilityModel *>,
+                             LinkLoss, LinkHash> m_linkLosses;
 };
 }
 }
@@ -141,6 +141,13 @@ ClassAEndDeviceLorawanMac::SendToPhy (Ptr<Packet> packetToSend)
   // Switch the PHY to the channel so that it will listen here for downlink
   m_phy->GetObject<EndDeviceLoraPhy> ()->SetFrequency (txChannel->GetFrequency ());
 
+  // Keep the PHY subscribed to both receive windows, so that it also gets
+  // the transmissions that start before it switches to the second one
+  std::vector<double> receiveWindowFrequencies;
+  receiveWindowFrequencies.push_back (txChannel->GetFrequency ());
+  receiveWindowFrequencies.push_back (m_secondReceiveWindowFrequency);
+  m_phy->GetObject<EndDeviceLoraPhy> ()->SetReceiveWindowFrequencies (receiveWindowFrequencies);
+
   // Instruct the PHY on the right Spreading Factor to listen for during the window
   // create a SetReplyDataRate function?
   uint8_t replyDataRate = GetFirstReceiveWindowDataRate ();
@@ -155,9 +162,10 @@ ClassAEndDeviceLorawanMac::SendToPhy (Ptr<Packet> packetToSend)
 //  Receiving methods   //
 //////////////////////////
 void
-ClassAEndDeviceLorawanMac::Receive (Ptr<Packet const> packet)
+ClassAEndDeviceLorawanMac::Receive (Ptr<Packet const> packet,
+                                    const LoraRxParameters &rxParams)
 {
-  NS_LOG_FUNCTION (this << packet);
+  NS_LOG_FUNCTION (this << packet << rxParams);
 
   // Work on a copy of the packet
   Ptr<Packet> packetCopy = packet->Copy ();
@@ -19,7 +19,17 @@
 #include "ns3/correlated-shadowing-propagation-loss-model.h"
 #include "ns3/double.h"
 #include "ns3/log.h"
+#include "ns3/rng-seed-manager.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace ns3 {
 namespace lorawan {
@@ -45,10 +55,28 @@ CorrelatedShadowingPropagationLossModel::GetTypeId (void)
   return tid;
 }
 
-CorrelatedShadowingPropagationLossModel::CorrelatedShadowingPropagationLossModel ()
+CorrelatedShadowingPropagationLossModel::CorrelatedShadowingPropagationLossModel () :
+  m_field (0),
+  m_fieldSize (0),
+  m_fieldVertices (0),
+  m_nFieldVertices (0),
+  m_fieldPositions (0),
+  m_nFieldPositions (0),
+  m_fieldXMin (std::numeric_limits<int32_t>::max ()),
+  m_fieldYMin (std::numeric_limits<int32_t>::max ()),
+  m_fieldXMax (std::numeric_limits<int32_t>::min ()),
+  m_fieldYMax (std::numeric_limits<int32_t>::min ()),
+  m_stream (-1)
 {
 }
 
+CorrelatedShadowingPropagationLossModel::~CorrelatedShadowingPropagationLossModel ()
+{
+  // Shadowing maps point to the mapped file
+  m_shadowingGrid.clear ();
+  UnmapField ();
+}
+
 double
 CorrelatedShadowingPropagationLossModel::DoCalcRxPower (double txPowerDbm,
                                                         Ptr<MobilityModel> a,
@@ -57,8 +85,8 @@ CorrelatedShadowingPropagationLossModel::DoCalcRxPower (double txPowerDbm,
   NS_LOG_FUNCTION (this << txPowerDbm << a << b);
 
   /*
-   * Check whether the a MobilityModel is in a grid square that already has
-   * its shadowing map.
+   * Check whether the shadowing of this link was already computed for the
+   * current position of b.
    */
   Vector position = a->GetPosition ();
 
@@ -66,49 +94,57 @@ CorrelatedShadowingPropagationLossModel::DoCalcRxPower (double txPowerDbm,
   double y = position.y;
 
   // Compute the coordinates of the grid square (i.e., round the raw position)
-  // (x > 0) - (x < 0) is the sign function
-  int xcoord =
-    ((x > 0) - (x < 0)) * ((std::fabs (x) + m_correlationDistance / 2) / m_correlationDistance);
-  int ycoord =
-    ((y > 0) - (y < 0)) * ((std::fabs (y) + m_correlationDistance / 2) / m_correlationDistance);
-
-  // Wrap coordinates up in a pair
-  std::pair<int, int> coordinates (xcoord, ycoord);
+  int xcoord = GetSquareCoordinate (x, m_correlationDistance);
+  int ycoord = GetSquareCoordinate (y, m_correlationDistance);
+  uint64_t square = GetKey (xcoord, ycoord);
 
   NS_LOG_DEBUG ("x " << x << ", y " << y);
   NS_LOG_DEBUG ("xcoord " << xcoord << ", ycoord " << ycoord);
 
-  // Look for the computed coordinates in the shadowingGrid
-  std::map<std::pair<int,int>, Ptr<ShadowingMap> >::const_iterator it;
-
-  it = m_shadowingGrid.find (coordinates);
+  Vector bPosition = b->GetPosition ();
+  std::pair<std::unordered_map<std::pair<uint64_t, const MobilityModel *>,
+                               LinkLoss, LinkHash>::iterator, bool> inserted =
+    m_linkLosses.insert (std::make_pair (std::make_pair (square, PeekPointer (b)),
+                                         LinkLoss ()));
+  LinkLoss &link = inserted.first->second;
 
-  if (it == m_shadowingGrid.end ())     // Did not find the coordinates
+  if (inserted.second || link.x != bPosition.x || link.y != bPosition.y)
     {
-      // If this shadowing grid was not found, create it
-      NS_LOG_DEBUG ("Creating a new shadowing map to be used at coordinates "
-                    << coordinates.first << " " << coordinates.second);
-
-      Ptr<ShadowingMap> shadowingMap =
-        Create<CorrelatedShadowingPropagationLossModel::ShadowingMap> ();
+      // Look for the computed coordinates in the shadowingGrid
+      Ptr<ShadowingMap> &shadowingMap = m_shadowingGrid[square];
+      if (shadowingMap == 0)
+        {
+          // If this shadowing grid was not found, create it
+          NS_LOG_DEBUG ("Creating a new shadowing map to be used at coordinates "
+                        << xcoord << " " << ycoord);
+
+          shadowingMap =
+            Create<CorrelatedShadowingPropagationLossModel::ShadowingMap> ();
+          if (m_shadowingValue != 0)
+            {
+              shadowingMap->SetRandomVariable (m_shadowingValue);
+            }
+          SetFieldVertices (square, shadowingMap);
+        }
 
-      m_shadowingGrid[coordinates] = shadowingMap;
+      // Use the map of the a MobilityModel to determine the value of
+      // shadowing that corresponds to the position of the MobilityModel b,
+      // unless it is in the mapped shadowing field.
+      link.x = bPosition.x;
+      link.y = bPosition.y;
+      if (!FindFieldPosition (square, bPosition.x, bPosition.y, link.loss))
+        {
+          link.loss = shadowingMap->GetLoss
+              (CorrelatedShadowingPropagationLossModel::Position (bPosition.x,
+                                                                  bPosition.y));
+        }
     }
   else
     {
-      NS_LOG_DEBUG ("This square already has its shadowingMap!");
+      NS_LOG_DEBUG ("The shadowing of this link was already computed");
     }
 
-  // Place the iterator on the coordinates
-  it = m_shadowingGrid.find (coordinates);
-
-  // Get b's position in a's ShadowingMap
-  CorrelatedShadowingPropagationLossModel::Position bPosition
-    (b->GetPosition ().x, b->GetPosition ().y);
-
-  // Use the map of the a MobilityModel to determine the value of shadowing
-  // that corresponds to the position of the MobilityModel b.
-  double loss = it->second->GetLoss (bPosition);
+  double loss = link.loss;
 
   NS_LOG_INFO ("Shadowing loss: " << loss);
 
@@ -118,7 +154,332 @@ CorrelatedShadowingPropagationLossModel::DoCalcRxPower (double txPowerDbm,
 int64_t
 CorrelatedShadowingPropagationLossModel::DoAssignStreams (int64_t stream)
 {
-  return 0;
+  NS_LOG_FUNCTION (this << stream);
+
+  // Maps are created on demand, so they all share a single random variable
+  // once a stream is assigned
+  m_stream = stream;
+  m_shadowingValue = CreateObject<NormalRandomVariable> ();
+  m_shadowingValue->SetAttribute ("Mean", DoubleValue (0.0));
+  m_shadowingValue->SetAttribute ("Variance", DoubleValue (16.0));
+  m_shadowingValue->SetStream (stream);
+
+  for (std::unordered_map<uint64_t, Ptr<ShadowingMap> >::const_iterator it =
+         m_shadowingGrid.begin (); it != m_shadowingGrid.end (); ++it)
+    {
+      it->second->SetRandomVariable (m_shadowingValue);
+    }
+
+  return 1;
+}
+
+int
+CorrelatedShadowingPropagationLossModel::GetSquareCoordinate (double coordinate,
+                                                              double correlationDistance)
+{
+  // (x > 0) - (x < 0) is the sign function
+  return static_cast<int> (((coordinate > 0) - (coordinate < 0)) *
+                           ((std::fabs (coordinate) + correlationDistance / 2) /
+                            correlationDistance));
+}
+
+uint64_t
+CorrelatedShadowingPropagationLossModel::GetKey (int x, int y)
+{
+  return (static_cast<uint64_t> (static_cast<uint32_t> (x)) << 32) |
+         static_cast<uint32_t> (y);
+}
+
+bool
+CorrelatedShadowingPropagationLossModel::ExportField (std::string filename) const
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  FieldHeader header;
+  std::memset (&header, 0, sizeof (header));
+  std::memcpy (header.magic, "LORASHF", sizeof (header.magic));
+  header.version = 2;
+  header.seed = RngSeedManager::GetSeed ();
+  header.run = RngSeedManager::GetRun ();
+  header.stream = m_stream;
+  header.correlationDistance = m_correlationDistance;
+  header.xMin = std::numeric_limits<int32_t>::max ();
+  header.yMin = std::numeric_limits<int32_t>::max ();
+  header.xMax = std::numeric_limits<int32_t>::min ();
+  header.yMax = std::numeric_limits<int32_t>::min ();
+
+  // Collect the vertices of each shadowing map
+  std::vector<FieldVertex> vertices;
+  for (std::unordered_map<uint64_t, Ptr<ShadowingMap> >::const_iterator it =
+         m_shadowingGrid.begin (); it != m_shadowingGrid.end (); ++it)
+    {
+      int32_t x = static_cast<int32_t> (it->first >> 32);
+      int32_t y = static_cast<int32_t> (it->first & 0xffffffff);
+      header.xMin = std::min (header.xMin, x);
+      header.yMin = std::min (header.yMin, y);
+      header.xMax = std::max (header.xMax, x);
+      header.yMax = std::max (header.yMax, y);
+
+      const std::unordered_map<uint64_t, double> &mapVertices =
+        it->second->GetVertices ();
+      for (std::unordered_map<uint64_t, double>::const_iterator vertex =
+             mapVertices.begin (); vertex != mapVertices.end (); ++vertex)
+        {
+          FieldVertex record = {it->first, vertex->first, vertex->second};
+          vertices.push_back (record);
+        }
+    }
+  std::sort (vertices.begin (), vertices.end (),
+             [] (const FieldVertex &a, const FieldVertex &b) {
+               return a.square < b.square ||
+               (a.square == b.square && a.vertex < b.vertex);
+             });
+
+  // Collect the loss computed for each position
+  std::vector<FieldPosition> positions;
+  for (std::unordered_map<std::pair<uint64_t, const MobilityModel *>,
+                          LinkLoss, LinkHash>::const_iterator it =
+         m_linkLosses.begin (); it != m_linkLosses.end (); ++it)
+    {
+      FieldPosition record = {it->first.first, it->second.x, it->second.y,
+                              it->second.loss};
+      positions.push_back (record);
+    }
+  std::sort (positions.begin (), positions.end (),
+             [] (const FieldPosition &a, const FieldPosition &b) {
+               return a.square < b.square ||
+               (a.square == b.square && (a.x < b.x ||
+                                         (a.x == b.x && a.y < b.y)));
+             });
+  positions.erase (std::unique (positions.begin (), positions.end (),
+                                [] (const FieldPosition &a, const FieldPosition &b) {
+                                  return a.square == b.square &&
+                                  a.x == b.x && a.y == b.y;
+                                }),
+                   positions.end ());
+
+  header.nVertices = vertices.size ();
+  header.nPositions = positions.size ();
+
+  std::ofstream file (filename.c_str (), std::ofstream::out |
+                      std::ofstream::binary | std::ofstream::trunc);
+  if (!file.is_open ())
+    {
+      NS_LOG_ERROR ("Cannot open " << filename << " for writing");
+      return false;
+    }
+  file.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  if (!vertices.empty ())
+    {
+      file.write (reinterpret_cast<const char *> (&vertices[0]),
+                  vertices.size () * sizeof (FieldVertex));
+    }
+  if (!positions.empty ())
+    {
+      file.write (reinterpret_cast<const char *> (&positions[0]),
+                  positions.size () * sizeof (FieldPosition));
+    }
+
+  NS_LOG_INFO ("Exported " << vertices.size () << " vertices and " <<
+               positions.size () << " positions to " << filename);
+
+  return file.good ();
+}
+
+bool
+CorrelatedShadowingPropagationLossModel::LoadField (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  UnmapField ();
+
+  int fd = open (filename.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      NS_LOG_INFO ("Cannot open " << filename);
+      return false;
+    }
+  struct stat status;
+  if (fstat (fd, &status) != 0 ||
+      static_cast<std::size_t> (status.st_size) < sizeof (FieldHeader))
+    {
+      NS_LOG_ERROR (filename << " is not a shadowing field file");
+      close (fd);
+      return false;
+    }
+  std::size_t size = status.st_size;
+  void *field = mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (field == MAP_FAILED)
+    {
+      NS_LOG_ERROR ("Cannot map " << filename);
+      return false;
+    }
+
+  const FieldHeader *header = static_cast<const FieldHeader *> (field);
+  bool valid = std::memcmp (header->magic, "LORASHF", sizeof (header->magic)) == 0
+    && header->version == 2
+    && size == sizeof (FieldHeader) + header->nVertices * sizeof (FieldVertex)
+    + header->nPositions * sizeof (FieldPosition);
+  if (!valid)
+    {
+      NS_LOG_ERROR (filename << " is not a shadowing field file");
+      munmap (field, size);
+      return false;
+    }
+
+  // Only use a field that was generated in the same conditions
+  if (header->correlationDistance != m_correlationDistance
+      || header->seed != RngSeedManager::GetSeed ()
+      || header->run != RngSeedManager::GetRun ()
+      || header->stream != m_stream)
+    {
+      NS_LOG_INFO (filename << " was generated with a different correlation "
+                   "distance, seed, run or stream");
+      munmap (field, size);
+      return false;
+    }
+
+  // Lookups outside the area recorded in the header are skipped, so all the
+  // squares in the file must lie within it
+  const FieldVertex *vertices = reinterpret_cast<const FieldVertex *> (header + 1);
+  const FieldPosition *positions =
+    reinterpret_cast<const FieldPosition *> (vertices + header->nVertices);
+  auto inArea = [header] (uint64_t square) {
+                  int32_t x = static_cast<int32_t> (square >> 32);
+                  int32_t y = static_cast<int32_t> (square & 0xffffffff);
+                  return header->xMin <= x && x <= header->xMax &&
+                         header->yMin <= y && y <= header->yMax;
+                };
+  for (uint64_t i = 0; i < header->nVertices && valid; i++)
+    {
+      valid = inArea (vertices[i].square);
+    }
+  for (uint64_t i = 0; i < header->nPositions && valid; i++)
+    {
+      valid = inArea (positions[i].square);
+    }
+  if (!valid)
+    {
+      NS_LOG_ERROR (filename << " has squares outside of the area in its header");
+      munmap (field, size);
+      return false;
+    }
+
+  m_field = field;
+  m_fieldSize = size;
+  m_fieldVertices = reinterpret_cast<const FieldVertex *> (header + 1);
+  m_nFieldVertices = header->nVertices;
+  m_fieldPositions =
+    reinterpret_cast<const FieldPosition *> (m_fieldVertices + m_nFieldVertices);
+  m_nFieldPositions = header->nPositions;
+  m_fieldXMin = header->xMin;
+  m_fieldYMin = header->yMin;
+  m_fieldXMax = header->xMax;
+  m_fieldYMax = header->yMax;
+
+  NS_LOG_INFO ("Mapped " << m_nFieldVertices << " vertices and " <<
+               m_nFieldPositions << " positions covering squares (" <<
+               header->xMin << ", " << header->yMin << ") to (" <<
+               header->xMax << ", " << header->yMax << ")");
+
+  // Maps that already exist can use the field too
+  for (std::unordered_map<uint64_t, Ptr<ShadowingMap> >::const_iterator it =
+         m_shadowingGrid.begin (); it != m_shadowingGrid.end (); ++it)
+    {
+      SetFieldVertices (it->first, it->second);
+    }
+
+  return true;
+}
+
+void
+CorrelatedShadowingPropagationLossModel::UnmapField (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_field != 0)
+    {
+      for (std::unordered_map<uint64_t, Ptr<ShadowingMap> >::const_iterator it =
+             m_shadowingGrid.begin (); it != m_shadowingGrid.end (); ++it)
+        {
+          it->second->SetFieldVertices (0, 0);
+        }
+      munmap (m_field, m_fieldSize);
+      m_field = 0;
+      m_fieldSize = 0;
+      m_fieldVertices = 0;
+      m_nFieldVertices = 0;
+      m_fieldPositions = 0;
+      m_nFieldPositions = 0;
+      m_fieldXMin = std::numeric_limits<int32_t>::max ();
+      m_fieldYMin = std::numeric_limits<int32_t>::max ();
+      m_fieldXMax = std::numeric_limits<int32_t>::min ();
+      m_fieldYMax = std::numeric_limits<int32_t>::min ();
+    }
+}
+
+bool
+CorrelatedShadowingPropagationLossModel::IsInField (uint64_t square) const
+{
+  int32_t x = static_cast<int32_t> (square >> 32);
+  int32_t y = static_cast<int32_t> (square & 0xffffffff);
+  return m_fieldXMin <= x && x <= m_fieldXMax && m_fieldYMin <= y && y <= m_fieldYMax;
+}
+
+bool
+CorrelatedShadowingPropagationLossModel::FindFieldPosition (uint64_t square,
+                                                            double x, double y,
+                                                            double &loss) const
+{
+  if (m_nFieldPositions == 0 || !IsInField (square))
+    {
+      return false;
+    }
+
+  FieldPosition key = {square, x, y, 0};
+  const FieldPosition *end = m_fieldPositions + m_nFieldPositions;
+  const FieldPosition *position =
+    std::lower_bound (m_fieldPositions, end, key,
+                      [] (const FieldPosition &a, const FieldPosition &b) {
+                        return a.square < b.square ||
+                        (a.square == b.square && (a.x < b.x ||
+                                                  (a.x == b.x && a.y < b.y)));
+                      });
+  if (position != end && position->square == square &&
+      position->x == x && position->y == y)
+    {
+      loss = position->loss;
+      return true;
+    }
+  return false;
+}
+
+void
+CorrelatedShadowingPropagationLossModel::SetFieldVertices
+  (uint64_t square, Ptr<ShadowingMap> shadowingMap) const
+{
+  if (m_nFieldVertices == 0 || !IsInField (square))
+    {
+      return;
+    }
+
+  FieldVertex first = {square, 0, 0};
+  FieldVertex last = {square, std::numeric_limits<uint64_t>::max (), 0};
+  const FieldVertex *end = m_fieldVertices + m_nFieldVertices;
+  const FieldVertex *begin =
+    std::lower_bound (m_fieldVertices, end, first,
+                      [] (const FieldVertex &a, const FieldVertex &b) {
+                        return a.square < b.square ||
+                        (a.square == b.square && a.vertex < b.vertex);
+                      });
+  const FieldVertex *stop =
+    std::upper_bound (begin, end, last,
+                      [] (const FieldVertex &a, const FieldVertex &b) {
+                        return a.square < b.square ||
+                        (a.square == b.square && a.vertex < b.vertex);
+                      });
+  shadowingMap->SetFieldVertices (begin, stop);
 }
 
 /*********************************
@@ -135,6 +496,8 @@ const double CorrelatedShadowingPropagationLossModel::ShadowingMap::m_kInv[4][4]
 };
 
 CorrelatedShadowingPropagationLossModel::ShadowingMap::ShadowingMap () :
+  m_fieldVerticesBegin (0),
+  m_fieldVerticesEnd (0),
   m_correlationDistance (110)
 {
   NS_LOG_FUNCTION_NOARGS ();
@@ -157,104 +520,117 @@ CorrelatedShadowingPropagationLossModel::ShadowingMap::GetLoss
 {
   NS_LOG_FUNCTION (this << position.x << position.y);
 
-  // Verify whether this position is already in the shadowingMap. Since the
-  // Position implementation overloads the == operator, this comparison
-  // between doubles is ok and we can use std::map's find function.
-  std::map<CorrelatedShadowingPropagationLossModel::Position,
-           double>::const_iterator it;
-  it = m_shadowingMap.find (position);
-
-  // If it's not found (i.e, if find returns the end of the map), we need to
-  // generate the value at the specified position.
-  if (it == m_shadowingMap.end ())
+  // Get the coordinates of the position
+  double x = position.x;
+  double y = position.y;
+  int xcoord = GetSquareCoordinate (x, m_correlationDistance);
+  int ycoord = GetSquareCoordinate (y, m_correlationDistance);
+
+  double xmin = xcoord * m_correlationDistance - m_correlationDistance / 2;
+  double xmax = xcoord * m_correlationDistance + m_correlationDistance / 2;
+  double ymin = ycoord * m_correlationDistance - m_correlationDistance / 2;
+  double ymax = ycoord * m_correlationDistance + m_correlationDistance / 2;
+
+  NS_LOG_DEBUG ("Interpolating a shadowing value in the following quadrant:");
+  NS_LOG_DEBUG ("xmin " << xmin << ", xmax " << xmax <<
+                ", ymin " << ymin << ", ymax " << ymax);
+
+  // Get the values at the 4 vertices of the square. Vertex (i, j) is shared
+  // by squares (i - 1, j - 1), (i - 1, j), (i, j - 1) and (i, j).
+  double q11 = GetVertex (xcoord, ycoord);
+  NS_LOG_DEBUG ("Lower left corner: " << q11);
+  double q12 = GetVertex (xcoord, ycoord + 1);
+  NS_LOG_DEBUG ("Upper left corner: " << q12);
+  double q21 = GetVertex (xcoord + 1, ycoord);
+  NS_LOG_DEBUG ("Lower right corner: " << q21);
+  double q22 = GetVertex (xcoord + 1, ycoord + 1);
+  NS_LOG_DEBUG ("Upper right corner: " << q22);
+
+  NS_LOG_DEBUG (q11 << " " << q12 << " " << q21 << " " << q22 << " ");
+
+  // The c matrix contains the positions of the 4 vertices
+  double c[2][4] = {{xmin, xmax, xmax, xmin}, {ymin, ymin, ymax, ymax}};
+
+  // For the following procedure, reference:
+  // S. Schlegel et al., "On the Interpolation of Data with Normally
+  // Distributed Uncertainty for Visualization", IEEE Transactions on
+  // Visualization and Computer Graphics, vol. 18, no. 12, Dec. 2012.
+
+  // Compute the phi coefficients
+  double phi1 = 0;
+  double phi2 = 0;
+  double phi3 = 0;
+  double phi4 = 0;
+
+  for (int j = 0; j < 4; j++)
     {
-      // Get the coordinates of the position
-      double x = position.x;
-      double y = position.y;
-      int xcoord =
-        ((x > 0) - (x < 0)) * ((std::fabs (x) + m_correlationDistance / 2) / m_correlationDistance);
-      int ycoord =
-        ((y > 0) - (y < 0)) * ((std::fabs (y) + m_correlationDistance / 2) / m_correlationDistance);
-
-      // Verify whether there already are the 4 surrounding positions in the
-      // map
-      double xmin = xcoord * m_correlationDistance - m_correlationDistance / 2;
-      double xmax = xcoord * m_correlationDistance + m_correlationDistance / 2;
-      double ymin = ycoord * m_correlationDistance - m_correlationDistance / 2;
-      double ymax = ycoord * m_correlationDistance + m_correlationDistance / 2;
-
-      CorrelatedShadowingPropagationLossModel::Position lowerLeft (xmin, ymin);
-      CorrelatedShadowingPropagationLossModel::Position upperLeft (xmin, ymax);
-      CorrelatedShadowingPropagationLossModel::Position lowerRight (xmax, ymin);
-      CorrelatedShadowingPropagationLossModel::Position upperRight (xmax, ymax);
-
-      NS_LOG_DEBUG ("Generating a new shadowing value in the following quadrant:");
-      NS_LOG_DEBUG ("xmin " << xmin << ", xmax " << xmax <<
-                    ", ymin " << ymin << ", ymax " << ymax);
-
-      // Use the map's insert method to insert the coordinates of the 4
-      // surrounding positions (if they are already there, they won't be
-      // substituted thanks to the map's implementation).
-      // TODO: Avoid useless generation of ShadowingMap values. This can be
-      // done by performing some checks (and not leveraging the map
-      // implementation)
-      double q11 = m_shadowingValue->GetValue ();
-      NS_LOG_DEBUG ("Lower left corner: " << q11);
-      m_shadowingMap[lowerLeft] = q11;
-      double q12 = m_shadowingValue->GetValue ();
-      NS_LOG_DEBUG ("Upper left corner: " << q12);
-      m_shadowingMap[upperLeft] = q12;
-      double q21 = m_shadowingValue->GetValue ();
-      NS_LOG_DEBUG ("Lower right corner: " << q21);
-      m_shadowingMap[lowerRight] = q21;
-      double q22 = m_shadowingValue->GetValue ();
-      NS_LOG_DEBUG ("Upper right corner: " << q22);
-      m_shadowingMap[upperRight] = q22;
-
-      NS_LOG_DEBUG (q11 << " " << q12 << " " << q21 << " " << q22 << " ");
-
-      // The c matrix contains the positions of the 4 vertices
-      double c[2][4] = {{xmin, xmax, xmax, xmin}, {ymin, ymin, ymax, ymax}};
-
-      // For the following procedure, reference:
-      // S. Schlegel et al., "On the Interpolation of Data with Normally
-      // Distributed Uncertainty for Visualization", IEEE Transactions on
-      // Visualization and Computer Graphics, vol. 18, no. 12, Dec. 2012.
-
-      // Compute the phi coefficients
-      double phi1 = 0;
-      double phi2 = 0;
-      double phi3 = 0;
-      double phi4 = 0;
-
-      for (int j = 0; j < 4; j++)
-        {
-          double distance = sqrt ((c[0][j] - x) * (c[0][j] - x) + (c[1][j] - y) * (c[1][j] - y));
+      double distance = sqrt ((c[0][j] - x) * (c[0][j] - x) + (c[1][j] - y) * (c[1][j] - y));
 
-          NS_LOG_DEBUG ("Distance: " << distance);
+      NS_LOG_DEBUG ("Distance: " << distance);
 
-          double k = std::exp (-distance / m_correlationDistance);
-          phi1 = phi1 + m_kInv[0][j] * k;
-          phi2 = phi2 + m_kInv[1][j] * k;
-          phi3 = phi3 + m_kInv[2][j] * k;
-          phi4 = phi4 + m_kInv[3][j] * k;
-        }
+      double k = std::exp (-distance / m_correlationDistance);
+      phi1 = phi1 + m_kInv[0][j] * k;
+      phi2 = phi2 + m_kInv[1][j] * k;
+      phi3 = phi3 + m_kInv[2][j] * k;
+      phi4 = phi4 + m_kInv[3][j] * k;
+    }
 
-      NS_LOG_DEBUG ("Phi: " << phi1 << " " << phi2 << " " << phi3 << " " <<
-                    phi4 << " ");
+  NS_LOG_DEBUG ("Phi: " << phi1 << " " << phi2 << " " << phi3 << " " <<
+                phi4 << " ");
 
-      double shadowing = q11 * phi1 + q21 * phi2 + q22 * phi3 + q12 * phi4;
+  double shadowing = q11 * phi1 + q21 * phi2 + q22 * phi3 + q12 * phi4;
+  NS_LOG_DEBUG ("Interpolated shadowing value: " << shadowing);
 
-      // Add the newly computed shadowing value to the shadowing map
-      m_shadowingMap[position] = shadowing;
-      NS_LOG_DEBUG ("Created new shadowing map: " << shadowing);
-    }
-  else
+  return shadowing;
+}
+
+double
+CorrelatedShadowingPropagationLossModel::ShadowingMap::GetVertex (int x, int y)
+{
+  uint64_t key = GetKey (x, y);
+  std::pair<std::unordered_map<uint64_t, double>::iterator, bool> inserted =
+    m_vertices.insert (std::make_pair (key, 0.0));
+  if (inserted.second)
     {
-      NS_LOG_DEBUG ("Shadowing map for this location already exists");
+      // Use the value in the shadowing field, if any
+      FieldVertex vertex = {0, key, 0};
+      const FieldVertex *field =
+        std::lower_bound (m_fieldVerticesBegin, m_fieldVerticesEnd, vertex,
+                          [] (const FieldVertex &a, const FieldVertex &b) {
+                            return a.vertex < b.vertex;
+                          });
+      if (field != m_fieldVerticesEnd && field->vertex == key)
+        {
+          inserted.first->second = field->value;
+          return inserted.first->second;
+        }
+
+      inserted.first->second = m_shadowingValue->GetValue ();
+      NS_LOG_DEBUG ("Generated vertex (" << x << ", " << y << "): " <<
+                    inserted.first->second);
     }
+  return inserted.first->second;
+}
 
-  return m_shadowingMap[position];
+void
+CorrelatedShadowingPropagationLossModel::ShadowingMap::SetFieldVertices
+  (const FieldVertex *begin, const FieldVertex *end)
+{
+  m_fieldVerticesBegin = begin;
+  m_fieldVerticesEnd = end;
+}
+
+void
+CorrelatedShadowingPropagationLossModel::ShadowingMap::SetRandomVariable
+  (Ptr<NormalRandomVariable> shadowingValue)
+{
+  m_shadowingValue = shadowingValue;
+}
+
+const std::unordered_map<uint64_t, double> &
+CorrelatedShadowingPropagationLossModel::ShadowingMap::GetVertices (void) const
+{
+  return m_vertices;
 }
 
 /*****************************
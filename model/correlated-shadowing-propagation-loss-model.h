@@ -23,6 +23,9 @@
 #include "ns3/mobility-model.h"
 #include "ns3/vector.h"
 #include "ns3/random-variable-stream.h"
+#include <string>
+#include <unordered_map>
+#include <utility>
 
 namespace ns3 {
 class MobilityModel;
@@ -44,6 +47,29 @@ public:
     bool operator< (const Position &other) const;
   };
 
+  /**
+   * The shadowing value at a vertex of the grid of a ShadowingMap, as stored
+   * in a shadowing field file.
+   */
+  struct FieldVertex
+  {
+    uint64_t square;  //!< The key of the square the ShadowingMap belongs to
+    uint64_t vertex;  //!< The key of the vertex
+    double value;     //!< The shadowing value
+  };
+
+  /**
+   * The shadowing loss computed for a position, as stored in a shadowing
+   * field file.
+   */
+  struct FieldPosition
+  {
+    uint64_t square;  //!< The key of the square the ShadowingMap belongs to
+    double x;         //!< The x coordinate of the position
+    double y;         //!< The y coordinate of the position
+    double loss;      //!< The shadowing loss
+  };
+
   class ShadowingMap : public
                        SimpleRefCount<CorrelatedShadowingPropagationLossModel::ShadowingMap>
   {
@@ -62,31 +88,66 @@ public:
      *  o---o---o---o---o
      *  where at each o we have an independently generated shadowing value.
      *  We can then interpolate the 4 values surrounding any point in space
-     *  in order to get a correlated shadowing value. After generating this
-     *  value, we will add it to the map so that we don't have to compute it
-     *  twice. Also, since interpolation is a deterministic operation, we are
-     *  guaranteed that, as long as the grid doesn't change, also two values
-     *  generated in the same square will be correlated.
+     *  in order to get a correlated shadowing value. Vertices are generated
+     *  the first time a square that touches them is used, and are then shared
+     *  by all the squares around them. Since interpolation is a deterministic
+     *  operation, two values generated in the same square, or in neighboring
+     *  squares, will be correlated.
      */
     ShadowingMap ();
 
     ~ShadowingMap ();
 
     /**
-     * Get the loss for a certain position.
-     * If this position is not already in the map, add it by computing the
-     * interpolation of neighboring shadowing values belonging to the grid.
+     * Get the loss for a certain position, computed by interpolating the
+     * shadowing values at the vertices of the grid square the position
+     * belongs to. Vertices that do not exist yet are generated.
      */
     double GetLoss (CorrelatedShadowingPropagationLossModel::Position position);
 
+    /**
+     * Set the vertices of this map loaded from a shadowing field file. These
+     * are used instead of generating new values.
+     *
+     * \param begin The first vertex of this map, sorted by vertex key.
+     * \param end Past the last vertex of this map.
+     */
+    void SetFieldVertices (const FieldVertex *begin, const FieldVertex *end);
+
+    /**
+     * Set the random variable used to generate new shadowing values.
+     *
+     * \param shadowingValue The random variable.
+     */
+    void SetRandomVariable (Ptr<NormalRandomVariable> shadowingValue);
+
+    /**
+     * Get the vertices that were used so far, keyed by the pair of indexes
+     * of the vertex.
+     */
+    const std::unordered_map<uint64_t, double> &GetVertices (void) const;
+
 private:
     /**
-     * For each Position, this map gives a corresponding loss.
-     * The map contains a basic grid that is initialized at construction
-     * time, and then newly computed values are added as they are created.
+     * Get the shadowing value at a vertex of the grid, generating it if it
+     * doesn't exist yet.
+     *
+     * \param x The horizontal index of the vertex.
+     * \param y The vertical index of the vertex.
+     */
+    double GetVertex (int x, int y);
+
+    /**
+     * The shadowing value at each vertex of the grid that was generated so
+     * far, keyed by the pair of indexes of the vertex.
      */
-    std::map<CorrelatedShadowingPropagationLossModel::Position, double>
-    m_shadowingMap;
+    std::unordered_map<uint64_t, double> m_vertices;
+
+    /**
+     * The range of vertices loaded from a shadowing field file.
+     */
+    const FieldVertex *m_fieldVerticesBegin;
+    const FieldVertex *m_fieldVerticesEnd;
 
     /**
      * The distance after which two samples are to be considered almost
@@ -114,6 +175,8 @@ private:
    */
   CorrelatedShadowingPropagationLossModel ();
 
+  ~CorrelatedShadowingPropagationLossModel ();
+
   /**
    * Set the correlation distance for newly created ShadowingMap instances
    */
@@ -124,6 +187,37 @@ private:
    */
   double GetCorrelationDistance (void);
 
+  /**
+   * Write the shadowing field generated so far, i.e., the values at the grid
+   * vertices and the loss computed for each position, to a binary file.
+   *
+   * The file also records the correlation distance, the seed and run number
+   * of the simulation, the stream assigned to this model, and the area
+   * covered by the field, so that it is only reused by simulations that would
+   * generate the same field.
+   *
+   * If no stream was assigned with AssignStreams, the values depend on the
+   * streams automatically given to the random variables, so a field should
+   * only be reused by a simulation that creates them in the same order.
+   *
+   * \param filename The name of the file to write.
+   * \return Whether the file was written.
+   */
+  bool ExportField (std::string filename) const;
+
+  /**
+   * Memory-map a shadowing field file written by ExportField.
+   *
+   * The values stored in the file are then looked up instead of being
+   * generated. The file is only used if it was generated with the current
+   * correlation distance, seed, run number and assigned stream, and if all
+   * of its squares lie within the area recorded in its header.
+   *
+   * \param filename The name of the file to map.
+   * \return Whether the file was mapped.
+   */
+  bool LoadField (std::string filename);
+
 private:
   virtual double DoCalcRxPower (double txPowerDbm,
                                 Ptr<MobilityModel> a,
@@ -131,8 +225,125 @@ private:
 
   virtual int64_t DoAssignStreams (int64_t stream);
 
+  /**
+   * Get the coordinate of the grid square a coordinate belongs to.
+   *
+   * \param coordinate The x or y coordinate of a point, in meters.
+   * \param correlationDistance The side of a grid square, in meters.
+   */
+  static int GetSquareCoordinate (double coordinate, double correlationDistance);
+
+  /**
+   * Combine a pair of grid coordinates in a single key.
+   */
+  static uint64_t GetKey (int x, int y);
+
+  /**
+   * Unmap the shadowing field file, if any.
+   */
+  void UnmapField (void);
+
+  /**
+   * Look up the loss of a position in the mapped shadowing field.
+   *
+   * \param square The key of the square of the first node.
+   * \param x The x coordinate of the second node.
+   * \param y The y coordinate of the second node.
+   * \param loss Set to the loss, if found.
+   * \return Whether the position was found.
+   */
+  bool FindFieldPosition (uint64_t square, double x, double y, double &loss) const;
+
+  /**
+   * Give a ShadowingMap the vertices of its square in the mapped shadowing
+   * field.
+   */
+  void SetFieldVertices (uint64_t square, Ptr<ShadowingMap> shadowingMap) const;
+
+  /**
+   * Get whether a square lies within the area covered by the mapped
+   * shadowing field.
+   *
+   * \param square The key of the square.
+   */
+  bool IsInField (uint64_t square) const;
+
+  /**
+   * The header of a shadowing field file. It is followed by the vertices,
+   * sorted by square and vertex key, and by the positions, sorted by square
+   * and coordinates.
+   */
+  struct FieldHeader
+  {
+    char magic[8];               //!< Identifies the file format
+    uint32_t version;            //!< The version of the file format
+    uint32_t seed;               //!< The seed of the simulation
+    uint64_t run;                //!< The run number of the simulation
+    int64_t stream;              //!< The stream assigned to the model, or -1
+    double correlationDistance;  //!< The correlation distance
+    int32_t xMin;                //!< The smallest x coordinate of a square
+    int32_t yMin;                //!< The smallest y coordinate of a square
+    int32_t xMax;                //!< The largest x coordinate of a square
+    int32_t yMax;                //!< The largest y coordinate of a square
+    uint64_t nVertices;          //!< The number of vertices
+    uint64_t nPositions;         //!< The number of positions
+  };
+
+  void *m_field;                            //!< The mapped file
+  std::size_t m_fieldSize;                  //!< The size of the mapped file
+  const FieldVertex *m_fieldVertices;       //!< The vertices in the file
+  std::size_t m_nFieldVertices;             //!< The number of vertices
+  const FieldPosition *m_fieldPositions;    //!< The positions in the file
+  std::size_t m_nFieldPositions;            //!< The number of positions
+  int32_t m_fieldXMin;                      //!< The smallest x coordinate of a square in the file
+  int32_t m_fieldYMin;                      //!< The smallest y coordinate of a square in the file
+  int32_t m_fieldXMax;                      //!< The largest x coordinate of a square in the file
+  int32_t m_fieldYMax;                      //!< The largest y coordinate of a square in the file
+
+  /**
+   * The stream assigned via AssignStreams, or -1 if none was assigned.
+   */
+  int64_t m_stream;
+
+  /**
+   * The random variable shared by all ShadowingMaps once a stream is
+   * assigned, or 0 if each map uses its own.
+   */
+  Ptr<NormalRandomVariable> m_shadowingValue;
+
   double m_correlationDistance;     //!< The correlation distance for the ShadowingMap
 
+  /**
+   * The shadowing loss last computed for a link, and the position of the
+   * receiver it was computed for.
+   */
+  struct LinkLoss
+  {
+    double x;
+    double y;
+    double loss;
+  };
+
+  /**
+   * Hash for a link, identified by the grid square of the first node and the
+   * mobility model of the second one.
+   */
+  struct LinkHash
+  {
+    std::size_t operator() (const std::pair<uint64_t, const MobilityModel *> &link) const
+    {
+      return std::hash<uint64_t> () (link.first) ^
+             (std::hash<const MobilityModel *> () (link.second) << 1);
+    }
+  };
+
+  /**
+   * The loss of each link, so that the interpolation is only computed again
+   * when the second node moves.
+   */
+  mutable std::unordered_map<std::pair<uint64_t, const MobilityModel *>,
+                             LinkLoss, LinkHash> m_linkLosses;
+
   /**
    * Map linking a square to a ShadowingMap.
    * Each square of the shadowing grid has a corresponding ShadowingMap, and a
@@ -161,16 +372,17 @@ private:
    *  |         |         |    '    |         |         |
    *  o---------o---------o---------o---------o---------o
    *
-   *  For each one of these coordinates, a ShadowingMap is computed. That is,
-   *  each one of the points belonging to the same square sees the same
-   *  shadowing for the points around it. This is one level of correlation for
+   *  For each one of these coordinates, a ShadowingMap is created, and it is
+   *  stored with the key given by GetKey. That is, each one of the points
+   *  belonging to the same square sees the same shadowing for the points
+   *  around it. This is one level of correlation for
    *  the shadowing, i.e. close nodes transmitting to the same point will see
    *  the same shadowing since they are using the same shadowing map.
    *  Further, the ShadowingMap will be "smooth": when transmitting from point
    *  a to points b and c, the shadowing experienced by b and c will be similar
    *  if they are close (ideally, within a correlation distance).
    */
-  mutable std::map<std::pair<int, int>, Ptr<ShadowingMap> > m_shadowingGrid;
+  mutable std::unordered_map<uint64_t, Ptr<ShadowingMap> > m_shadowingGrid;
 };
 
 }
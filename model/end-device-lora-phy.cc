@@ -118,10 +118,52 @@ EndDeviceLoraPhy::IsOnFrequency (double frequencyMHz)
   return m_frequency == frequencyMHz;
 }
 
+double
+EndDeviceLoraPhy::GetMinSensitivity (void) const
+{
+  return *std::min_element (sensitivity, sensitivity + 6);
+}
+
+std::vector<double>
+EndDeviceLoraPhy::GetListeningFrequencies (void) const
+{
+  std::vector<double> frequencies (1, m_frequency);
+  for (std::vector<double>::const_iterator it = m_receiveWindowFrequencies.begin ();
+       it != m_receiveWindowFrequencies.end (); ++it)
+    {
+      if (std::find (frequencies.begin (), frequencies.end (), *it) == frequencies.end ())
+        {
+          frequencies.push_back (*it);
+        }
+    }
+  return frequencies;
+}
+
+bool
+EndDeviceLoraPhy::IsListeningInvertedIq (void) const
+{
+  // End devices listen to downlinks
+  return true;
+}
+
 void
 EndDeviceLoraPhy::SetFrequency (double frequencyMHz)
 {
-  m_frequency = frequencyMHz;
+  if (m_frequency != frequencyMHz)
+    {
+      m_frequency = frequencyMHz;
+      UpdateFrequencySubscription ();
+    }
+}
+
+void
+EndDeviceLoraPhy::SetReceiveWindowFrequencies (const std::vector<double> &frequenciesMHz)
+{
+  if (m_receiveWindowFrequencies != frequenciesMHz)
+    {
+      m_receiveWindowFrequencies = frequenciesMHz;
+      UpdateFrequencySubscription ();
+    }
 }
 
 bool
@@ -185,7 +185,7 @@ public:
 
   // Implementation of LoraPhy's pure virtual functions
   virtual void StartReceive (Ptr<Packet> packet, double rxPowerDbm, uint8_t sf, Time duration,
-                             double frequencyMHz) = 0;
+                             double frequencyMHz, double bandwidthHz) = 0;
 
   // Implementation of LoraPhy's pure virtual functions
   virtual void EndReceive (Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event) = 0;
@@ -197,6 +197,12 @@ public:
   // Implementation of LoraPhy's pure virtual functions
   virtual bool IsOnFrequency (double frequencyMHz);
 
+  virtual double GetMinSensitivity (void) const;
+
+  virtual bool IsListeningInvertedIq (void) const;
+
+  virtual std::vector<double> GetListeningFrequencies (void) const;
+
   // Implementation of LoraPhy's pure virtual functions
   virtual bool IsTransmitting (void);
 
@@ -210,6 +216,17 @@ public:
    */
   void SetFrequency (double frequencyMHz);
 
+  /**
+   * Set the frequencies of the receive windows that follow a transmission.
+   *
+   * The PHY stays subscribed to these frequencies on the channel, in
+   * addition to the one it's listening on, so that transmissions that start
+   * before it switches to a receive window are still delivered to it.
+   *
+   * \param frequenciesMHz The frequencies [MHz] of the receive windows.
+   */
+  void SetReceiveWindowFrequencies (const std::vector<double> &frequenciesMHz);
+
   /**
    * Set the Spreading Factor this EndDevice will listen for.
    *
@@ -340,6 +357,8 @@ protected:
 
   double m_frequency; //!< The frequency this device is listening on
 
+  std::vector<double> m_receiveWindowFrequencies; //!< The frequencies of the receive windows
+
   uint8_t m_sf; //!< The Spreading Factor this device is listening for
 
   /**
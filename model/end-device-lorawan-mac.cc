@@ -406,7 +406,8 @@ EndDeviceLorawanMac::SendToPhy (Ptr<Packet> packet)
 //////////////////////////
 
 void
-EndDeviceLorawanMac::Receive (Ptr<Packet const> packet)
+EndDeviceLorawanMac::Receive (Ptr<Packet const> packet,
+                              const LoraRxParameters &rxParams)
 { }
 
 void
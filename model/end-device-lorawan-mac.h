@@ -92,8 +92,10 @@ public:
    * layer so that it's called when a packet is going up the stack.
    *
    * \param packet the received packet.
+   * \param rxParams the parameters of this reception.
    */
-  virtual void Receive (Ptr<Packet const> packet);
+  virtual void Receive (Ptr<Packet const> packet,
+                        const LoraRxParameters &rxParams);
 
   virtual void FailedReception (Ptr<Packet const> packet,
                                 bool lostBecauseInterference);
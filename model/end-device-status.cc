@@ -126,13 +126,7 @@ EndDeviceStatus::GetCompleteReplyPacket (void)
 
   // Add headers
   m_reply.frameHeader.SetAddress (m_endDeviceAddress);
-  Ptr<Packet> lastPacket = GetLastPacketReceivedFromDevice ()->Copy ();
-  LorawanMacHeader mHdr;
-  LoraFrameHeader fHdr;
-  fHdr.SetAsUplink ();
-  lastPacket->RemoveHeader (mHdr);
-  lastPacket->RemoveHeader (fHdr);
-  m_reply.frameHeader.SetFCnt (fHdr.GetFCnt ());
+  m_reply.frameHeader.SetFCnt (GetLastFrameHeaderReceivedFromDevice ().GetFCnt ());
   m_reply.macHeader.SetMType (LorawanMacHeader::UNCONFIRMED_DATA_DOWN);
   replyPacket->AddHeader (m_reply.frameHeader);
   replyPacket->AddHeader (m_reply.macHeader);
@@ -239,34 +233,25 @@ EndDeviceStatus::SetReplyPayload (Ptr<Packet> replyPayload)
 ///////////////////////
 
 void
-EndDeviceStatus::InsertReceivedPacket (Ptr<Packet const> receivedPacket, const Address &gwAddress)
+EndDeviceStatus::InsertReceivedPacket (const UplinkFrame &frame, const Address &gwAddress)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  // Create a copy of the packet
-  Ptr<Packet> myPacket = receivedPacket->Copy ();
-
-  // Extract the headers
-  LorawanMacHeader macHdr;
-  myPacket->RemoveHeader (macHdr);
-
-  LoraFrameHeader frameHdr;
-  frameHdr.SetAsUplink ();
-  myPacket->RemoveHeader (frameHdr);
+  const LoraFrameHeader &frameHdr = frame.frameHeader;
 
   // Update current parameters
-  LoraTag tag;
-  myPacket->RemovePacketTag (tag);
-  SetFirstReceiveWindowSpreadingFactor (tag.GetSpreadingFactor ());
-  SetFirstReceiveWindowFrequency (tag.GetFrequency ());
+  SetFirstReceiveWindowSpreadingFactor (frame.tag.GetSpreadingFactor ());
+  SetFirstReceiveWindowFrequency (frame.tag.GetFrequency ());
 
   // Update Information on the received packet
   ReceivedPacketInfo info;
-  info.sf = tag.GetSpreadingFactor ();
-  info.frequency = tag.GetFrequency ();
-  info.packet = receivedPacket;
+  info.sf = frame.tag.GetSpreadingFactor ();
+  info.frequency = frame.tag.GetFrequency ();
+  info.packet = frame.packet;
+  info.macHeader = frame.macHeader;
+  info.frameHeader = frameHdr;
 
-  double rcvPower = tag.GetReceivePower ();
+  double rcvPower = frame.tag.GetReceivePower ();
 
   // Perform insertion in list, also checking that the packet isn't already in
   // the list (it could have been received by another GW already)
@@ -277,12 +262,7 @@ EndDeviceStatus::InsertReceivedPacket (Ptr<Packet const> receivedPacket, const A
     {
       // Get the frame counter of the current packet to compare it with the
       // newly received one
-      Ptr<Packet> packetCopy = ((*it).first)->Copy ();
-      LorawanMacHeader currentMacHdr;
-      packetCopy->RemoveHeader (currentMacHdr);
-      LoraFrameHeader currentFrameHdr;
-      frameHdr.SetAsUplink ();
-      packetCopy->RemoveHeader (currentFrameHdr);
+      const LoraFrameHeader &currentFrameHdr = it->second.frameHeader;
 
       NS_LOG_DEBUG ("Received packet's frame counter: " << unsigned(frameHdr.GetFCnt ())
                                                         << "\nCurrent packet's frame counter: "
@@ -316,7 +296,7 @@ EndDeviceStatus::InsertReceivedPacket (Ptr<Packet const> receivedPacket, const A
       gwInfo.gwAddress = gwAddress;
       info.gwList.insert (std::pair<Address, PacketInfoPerGw> (gwAddress, gwInfo));
       m_receivedPacketList.push_back (
-          std::pair<Ptr<Packet const>, ReceivedPacketInfo> (receivedPacket, info));
+          std::pair<Ptr<Packet const>, ReceivedPacketInfo> (frame.packet, info));
     }
   NS_LOG_DEBUG (*this);
 }
@@ -351,6 +331,15 @@ EndDeviceStatus::GetLastPacketReceivedFromDevice (void)
     }
 }
 
+const LoraFrameHeader &
+EndDeviceStatus::GetLastFrameHeaderReceivedFromDevice (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  NS_ASSERT_MSG (!m_receivedPacketList.empty (),
+                 "No packet was received from this device");
+  return m_receivedPacketList.back ().second.frameHeader;
+}
+
 void
 EndDeviceStatus::InitializeReply ()
 {
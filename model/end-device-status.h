@@ -27,6 +27,7 @@
 #include "ns3/lorawan-mac-header.h"
 #include "ns3/class-a-end-device-lorawan-mac.h"
 #include "ns3/lora-frame-header.h"
+#include "ns3/lora-tag.h"
 #include "ns3/pointer.h"
 #include "ns3/lora-frame-header.h"
 #include <iostream>
@@ -147,6 +148,19 @@ public:
   /* Received packet list management */
   /***********************************/
 
+  /**
+   * Structure holding an uplink packet together with its headers and tag.
+   * The Network Server deserializes each packet only once, upon its arrival,
+   * and then passes this structure to its components.
+   */
+  struct UplinkFrame
+  {
+    Ptr<Packet const> packet;      //!< The received packet, headers included
+    LorawanMacHeader macHeader;    //!< The MAC header of the packet
+    LoraFrameHeader frameHeader;   //!< The frame header of the packet
+    LoraTag tag;                   //!< The tag set by the receiving gateway
+  };
+
   /**
    * Structure saving information regarding the packet reception in
    * each gateway.
@@ -168,6 +182,8 @@ public:
   {
     // Members
     Ptr<Packet const> packet = 0;   //!< The received packet
+    LorawanMacHeader macHeader;     //!< The MAC header of the packet
+    LoraFrameHeader frameHeader;    //!< The frame header of the packet
     GatewayList gwList;      //!< List of gateways that received this packet.
     uint8_t sf;
     double frequency;
@@ -265,7 +281,7 @@ public:
   /**
    * Insert a received packet in the packet list.
    */
-  void InsertReceivedPacket (Ptr<Packet const> receivedPacket,
+  void InsertReceivedPacket (const UplinkFrame &frame,
                              const Address& gwAddress);
 
   /**
@@ -273,6 +289,12 @@ public:
    */
   Ptr<Packet const> GetLastPacketReceivedFromDevice (void);
 
+  /**
+   * Return the frame header of the last packet that was received from this
+   * device. At least one packet must have been received.
+   */
+  const LoraFrameHeader &GetLastFrameHeaderReceivedFromDevice (void);
+
   /**
    * Return the information about the last packet that was received from the
    * device.
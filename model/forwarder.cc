@@ -19,6 +19,7 @@
  */
 
 #include "ns3/forwarder.h"
+#include "ns3/lora-tag.h"
 #include "ns3/log.h"
 
 namespace ns3 {
@@ -67,12 +68,18 @@ Forwarder::SetLoraNetDevice (Ptr<LoraNetDevice> loraNetDevice)
 
 bool
 Forwarder::ReceiveFromLora (Ptr<NetDevice> loraNetDevice, Ptr<const Packet>
-                            packet, uint16_t protocol, const Address& sender)
+                            packet, const LoraRxParameters &rxParams)
 {
-  NS_LOG_FUNCTION (this << packet << protocol << sender);
+  NS_LOG_FUNCTION (this << packet << rxParams);
 
   Ptr<Packet> packetCopy = packet->Copy ();
 
+  LoraTag tag;
+  packetCopy->RemovePacketTag (tag);
+  tag.SetReceivePower (rxParams.rxPowerDbm);
+  tag.SetFrequency (rxParams.frequencyMHz);
+  packetCopy->AddPacketTag (tag);
+
   m_pointToPointNetDevice->Send (packetCopy,
                                  m_pointToPointNetDevice->GetBroadcast (),
                                  0x800);
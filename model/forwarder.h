@@ -57,16 +57,20 @@ public:
   void SetPointToPointNetDevice (Ptr<PointToPointNetDevice> pointToPointNetDevice);
 
   /**
-   * Receive a packet from the LoraNetDevice.
+   * Receive a packet from the LoraNetDevice, together with the parameters of
+   * its reception at this gateway.
+   *
+   * The parameters are written in the LoraTag of the copy of the packet that
+   * is sent to the NS, since they can't travel alongside it on the
+   * point-to-point link.
    *
    * \param loraNetDevice The LoraNetDevice we received the packet from.
    * \param packet The packet we received.
-   * \param protocol The protocol number associated to this packet.
-   * \param sender The address of the sender.
+   * \param rxParams The parameters of the reception.
    * \returns True if we can handle the packet, false otherwise.
    */
   bool ReceiveFromLora (Ptr<NetDevice> loraNetDevice, Ptr<const Packet> packet,
-                        uint16_t protocol, const Address& sender);
+                        const LoraRxParameters &rxParams);
 
   /**
    * Receive a packet from the PointToPointNetDevice
@@ -22,6 +22,8 @@
 #include "ns3/lora-tag.h"
 #include "ns3/simulator.h"
 #include "ns3/log.h"
+#include "ns3/abort.h"
+#include <algorithm>
 
 namespace ns3 {
 namespace lorawan {
@@ -48,13 +50,13 @@ GatewayLoraPhy::ReceptionPath::~ReceptionPath (void)
 }
 
 double
-GatewayLoraPhy::ReceptionPath::GetFrequency (void)
+GatewayLoraPhy::ReceptionPath::GetFrequency (void) const
 {
   return m_frequencyMHz;
 }
 
 bool
-GatewayLoraPhy::ReceptionPath::IsAvailable (void)
+GatewayLoraPhy::ReceptionPath::IsAvailable (void) const
 {
   return m_available;
 }
@@ -139,6 +141,7 @@ GatewayLoraPhy::GetTypeId (void)
 }
 
 GatewayLoraPhy::GatewayLoraPhy () :
+  m_lockedPaths (0),
   m_isTransmitting (false)
 {
   NS_LOG_FUNCTION_NOARGS ();
@@ -159,8 +162,14 @@ GatewayLoraPhy::AddReceptionPath (double frequencyMHz)
 {
   NS_LOG_FUNCTION (this << frequencyMHz);
 
-  m_receptionPaths.push_back (Create<GatewayLoraPhy::ReceptionPath>
-                                (frequencyMHz));
+  NS_ABORT_MSG_IF (m_receptionPaths.size () >= 64,
+                   "A gateway can have at most 64 reception paths");
+
+  uint32_t path = m_receptionPaths.size ();
+  m_receptionPaths.push_back (GatewayLoraPhy::ReceptionPath (frequencyMHz));
+  m_availablePaths[frequencyMHz] |= uint64_t (1) << path;
+
+  UpdateFrequencySubscription ();
 }
 
 void
@@ -169,6 +178,46 @@ GatewayLoraPhy::ResetReceptionPaths (void)
   NS_LOG_FUNCTION (this);
 
   m_receptionPaths.clear ();
+  m_availablePaths.clear ();
+  m_lockedPaths = 0;
+
+  UpdateFrequencySubscription ();
+}
+
+uint32_t
+GatewayLoraPhy::GetAvailablePath (double frequencyMHz) const
+{
+  std::unordered_map<double, uint64_t>::const_iterator it =
+    m_availablePaths.find (frequencyMHz);
+  if (it == m_availablePaths.end () || it->second == 0)
+    {
+      return NO_PATH;
+    }
+
+  // Paths are used in the order they were added
+  return __builtin_ctzll (it->second);
+}
+
+void
+GatewayLoraPhy::LockPath (uint32_t path, Ptr<LoraInterferenceHelper::Event> event)
+{
+  NS_LOG_FUNCTION (this << path);
+
+  ReceptionPath &receptionPath = m_receptionPaths[path];
+  receptionPath.LockOnEvent (event);
+  m_availablePaths[receptionPath.GetFrequency ()] &= ~(uint64_t (1) << path);
+  m_lockedPaths |= uint64_t (1) << path;
+}
+
+void
+GatewayLoraPhy::FreePath (uint32_t path)
+{
+  NS_LOG_FUNCTION (this << path);
+
+  ReceptionPath &receptionPath = m_receptionPaths[path];
+  receptionPath.Free ();
+  m_availablePaths[receptionPath.GetFrequency ()] |= uint64_t (1) << path;
+  m_lockedPaths &= ~(uint64_t (1) << path);
 }
 
 void
@@ -188,22 +237,37 @@ GatewayLoraPhy::IsOnFrequency (double frequencyMHz)
 {
   NS_LOG_FUNCTION (this << frequencyMHz);
 
-  // Search every demodulator to see whether there's one listening on this
-  // frequency.
-  std::list< Ptr< GatewayLoraPhy::ReceptionPath > >::iterator it;
+  // Check whether there's a demodulator listening on this frequency
+  return m_availablePaths.find (frequencyMHz) != m_availablePaths.end ();
+}
+
+double
+GatewayLoraPhy::GetMinSensitivity (void) const
+{
+  return *std::min_element (sensitivity, sensitivity + 6);
+}
 
+std::vector<double>
+GatewayLoraPhy::GetListeningFrequencies (void) const
+{
+  std::vector<double> frequencies;
+  std::vector<GatewayLoraPhy::ReceptionPath>::const_iterator it;
   for (it = m_receptionPaths.begin (); it != m_receptionPaths.end (); ++it)
     {
-      Ptr<GatewayLoraPhy::ReceptionPath> currentPath = *it;
-
-      NS_LOG_DEBUG ("Current reception path is on frequency " <<
-                    currentPath->GetFrequency ());
-
-      if (currentPath->GetFrequency () == frequencyMHz)
+      double frequency = it->GetFrequency ();
+      if (std::find (frequencies.begin (), frequencies.end (), frequency) ==
+          frequencies.end ())
         {
-          return true;
+          frequencies.push_back (frequency);
         }
     }
+  return frequencies;
+}
+
+bool
+GatewayLoraPhy::IsListeningInvertedIq (void) const
+{
+  // Gateways listen to uplinks
   return false;
 }
 }
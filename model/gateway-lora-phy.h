@@ -28,7 +28,8 @@
 #include "ns3/node.h"
 #include "ns3/lora-phy.h"
 #include "ns3/traced-value.h"
-#include <list>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3 {
 namespace lorawan {
@@ -54,7 +55,7 @@ public:
   virtual ~GatewayLoraPhy ();
 
   virtual void StartReceive (Ptr<Packet> packet, double rxPowerDbm, uint8_t sf,
-                             Time duration, double frequencyMHz) = 0;
+                             Time duration, double frequencyMHz, double bandwidthHz) = 0;
 
   virtual void EndReceive (Ptr<Packet> packet,
                            Ptr<LoraInterferenceHelper::Event> event) = 0;
@@ -71,8 +72,15 @@ public:
 
   virtual bool IsOnFrequency (double frequencyMHz);
 
+  virtual double GetMinSensitivity (void) const;
+
+  virtual bool IsListeningInvertedIq (void) const;
+
+  virtual std::vector<double> GetListeningFrequencies (void) const;
+
   /**
-   * Add a reception path, locked on a specific frequency.
+   * Add a reception path, locked on a specific frequency. A gateway can have
+   * up to 64 reception paths.
    *
    * \param frequencyMHz The frequency on which to set this ReceptionPath.
    */
@@ -99,7 +107,7 @@ protected:
    * from EndDeviceLoraPhys, these do not need to be configured to listen for a
    * certain SF. ReceptionPaths be either locked on an event or free.
    */
-  class ReceptionPath : public SimpleRefCount<GatewayLoraPhy::ReceptionPath>
+  class ReceptionPath
   {
 
 public:
@@ -117,7 +125,7 @@ public:
      *
      * \return The frequency this ReceivePath is configured to listen on.
      */
-    double GetFrequency (void);
+    double GetFrequency (void) const;
 
     /**
      * Setter for the frequency.
@@ -131,7 +139,7 @@ public:
      *
      * \return True if its current state is free, false if it's currently locked.
      */
-    bool IsAvailable (void);
+    bool IsAvailable (void) const;
 
     /**
      * Set this reception path as available.
@@ -200,10 +208,50 @@ private:
   };
 
   /**
-   * A list containing the various parallel receivers that are managed by this
-   * Gateway.
+   * The index used to mean that no reception path was found.
+   */
+  static const uint32_t NO_PATH = 0xffffffff;
+
+  /**
+   * Get the first available reception path listening on a frequency.
+   *
+   * \param frequencyMHz The frequency of the signal to receive.
+   * \return The index of the path, or NO_PATH if all the paths listening on
+   * this frequency are locked.
+   */
+  uint32_t GetAvailablePath (double frequencyMHz) const;
+
+  /**
+   * Lock a reception path on an event.
+   *
+   * \param path The index of the path.
+   * \param event The LoraInterferenceHelper Event to lock on.
+   */
+  void LockPath (uint32_t path, Ptr<LoraInterferenceHelper::Event> event);
+
+  /**
+   * Free a reception path, making it available on its frequency.
+   *
+   * \param path The index of the path.
+   */
+  void FreePath (uint32_t path);
+
+  /**
+   * The various parallel receivers that are managed by this Gateway. A path's
+   * index in this vector is its bit in m_availablePaths and m_lockedPaths.
+   */
+  std::vector<ReceptionPath> m_receptionPaths;
+
+  /**
+   * For each frequency, the mask of the paths listening on it that are
+   * available.
+   */
+  std::unordered_map<double, uint64_t> m_availablePaths;
+
+  /**
+   * The mask of the paths that are locked on an event.
    */
-  std::list<Ptr<ReceptionPath> > m_receptionPaths;
+  uint64_t m_lockedPaths;
 
   /**
    * The number of occupied reception paths.
@@ -93,6 +93,7 @@ GatewayLorawanMac::Send (Ptr<Packet> packet)
   params.nPreamble = 8;
   params.crcEnabled = 1;
   params.lowDataRateOptimizationEnabled = 0;
+  params.invertedIq = 1;
 
   // Get the duration
   Time duration = m_phy->GetOnAirTime (packet, params);
@@ -120,9 +121,10 @@ GatewayLorawanMac::IsTransmitting (void)
 }
 
 void
-GatewayLorawanMac::Receive (Ptr<Packet const> packet)
+GatewayLorawanMac::Receive (Ptr<Packet const> packet,
+                            const LoraRxParameters &rxParams)
 {
-  NS_LOG_FUNCTION (this << packet);
+  NS_LOG_FUNCTION (this << packet << rxParams);
 
   // Make a copy of the packet to work on
   Ptr<Packet> packetCopy = packet->Copy ();
@@ -133,7 +135,7 @@ GatewayLorawanMac::Receive (Ptr<Packet const> packet)
 
   if (macHdr.IsUplink ())
     {
-      m_device->GetObject<LoraNetDevice> ()->Receive (packetCopy);
+      m_device->GetObject<LoraNetDevice> ()->Receive (packetCopy, rxParams);
 
       NS_LOG_DEBUG ("Received packet: " << packet);
 
@@ -22,12 +22,20 @@
 #include "ns3/log-macros-enabled.h"
 #include "ns3/log.h"
 #include "ns3/pointer.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
 #include "ns3/object-factory.h"
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/end-device-lora-phy.h"
 #include "ns3/gateway-lora-phy.h"
+#include "ns3/correlated-shadowing-propagation-loss-model.h"
+#include "ns3/building-penetration-loss.h"
+#include "ns3/constant-position-mobility-model.h"
 #include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
 
 namespace ns3 {
 namespace lorawan {
@@ -46,13 +54,85 @@ LoraChannel::GetTypeId (void)
     .AddAttribute ("PropagationLossModel",
                    "A pointer to the propagation loss model attached to this channel.",
                    PointerValue (),
-                   MakePointerAccessor (&LoraChannel::m_loss),
+                   MakePointerAccessor (&LoraChannel::SetPropagationLossModel,
+                                        &LoraChannel::GetPropagationLossModel),
                    MakePointerChecker<PropagationLossModel> ())
     .AddAttribute ("PropagationDelayModel",
                    "A pointer to the propagation delay model attached to this channel.",
                    PointerValue (),
                    MakePointerAccessor (&LoraChannel::m_delay),
                    MakePointerChecker<PropagationDelayModel> ())
+    .AddAttribute ("SharedInterferenceLedger",
+                   "Whether to record each transmission once in a ledger shared "
+                   "by all PHYs, instead of having each PHY store a copy of "
+                   "every signal it receives.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoraChannel::SetSharedInterferenceLedger,
+                                        &LoraChannel::GetSharedInterferenceLedger),
+                   MakeBooleanChecker ())
+    .AddAttribute ("OldEventThreshold",
+                   "Time after the end of a transmission after which it is "
+                   "removed from the shared interference ledger",
+                   TimeValue (Seconds (2)),
+                   MakeTimeAccessor (&LoraChannel::SetOldEventThreshold,
+                                     &LoraChannel::GetOldEventThreshold),
+                   MakeTimeChecker ())
+    .AddAttribute ("LinkBudgetCache",
+                   "Whether to compute the received power and delay of each "
+                   "link once, for the propagation models that are declared "
+                   "deterministic. Only links between PHYs with a "
+                   "ConstantPositionMobilityModel are cached.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoraChannel::SetLinkBudgetCache,
+                                        &LoraChannel::GetLinkBudgetCache),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FrequencySubscriptions",
+                   "Whether to only deliver transmissions to the PHYs that "
+                   "currently listen on their frequency",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoraChannel::SetFrequencySubscriptions,
+                                        &LoraChannel::GetFrequencySubscriptions),
+                   MakeBooleanChecker ())
+    .AddAttribute ("IqPolarityFiltering",
+                   "Whether to only deliver transmissions to the PHYs that "
+                   "listen with the same IQ polarity, so that uplinks only "
+                   "reach gateways and downlinks only reach end devices",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoraChannel::m_iqPolarityFiltering),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FanOutDelivery",
+                   "Whether to deliver the receptions of a transmission one "
+                   "after the other, keeping a single event per transmission "
+                   "in the scheduler instead of one per receiver",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoraChannel::m_fanOutDelivery),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FanOutDelayResolution",
+                   "With FanOutDelivery, propagation delays are rounded down "
+                   "to a multiple of this value. Zero keeps the exact delays, "
+                   "while a value larger than any delay neglects them.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&LoraChannel::m_fanOutDelayResolution),
+                   MakeTimeChecker ())
+    .AddAttribute ("ReceiverCulling",
+                   "Whether to only deliver transmissions to the PHYs within "
+                   "the range derived from the path loss model and the "
+                   "lowest sensitivity of the PHYs. Only PHYs with a "
+                   "ConstantPositionMobilityModel are placed in the culling "
+                   "grid, other PHYs are checked against their current "
+                   "position on every transmission. Since culled links are "
+                   "not evaluated, random models in the loss chain draw "
+                   "fewer values, so enabling this changes the results of "
+                   "a simulation, including for the PHYs in range.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoraChannel::m_receiverCulling),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CullingMarginDb",
+                   "How far below the lowest sensitivity a transmission can "
+                   "still be delivered when ReceiverCulling is enabled",
+                   DoubleValue (20),
+                   MakeDoubleAccessor (&LoraChannel::m_cullingMarginDb),
+                   MakeDoubleChecker<double> (0))
     .AddTraceSource ("PacketSent",
                      "Trace source fired whenever a packet goes out on the channel",
                      MakeTraceSourceAccessor (&LoraChannel::m_packetSent),
@@ -60,20 +140,69 @@ LoraChannel::GetTypeId (void)
   return tid;
 }
 
-LoraChannel::LoraChannel ()
+LoraChannel::LoraChannel () :
+  m_sharedLedger (false),
+  m_linkBudgetCache (false),
+  m_tableValid (false),
+  m_frequencySubscriptions (false),
+  m_iqPolarityFiltering (false),
+  m_fanOutDelivery (false),
+  m_fanOutDelayResolution (Seconds (0)),
+  m_receiverCulling (false),
+  m_cullingMarginDb (20),
+  m_gridValid (false),
+  m_gridCellSize (0),
+  m_minSensitivity (0)
 {
 }
 
+void
+LoraChannel::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+
+  m_loss = loss;
+  m_pathLoss = GetPathLossParameters (loss);
+  InvalidateReceiverTable ();
+}
+
+Ptr<PropagationLossModel>
+LoraChannel::GetPropagationLossModel (void) const
+{
+  return m_loss;
+}
+
 LoraChannel::~LoraChannel ()
 {
+  // Make sure no PHY keeps pointing to our ledger, and no mobility model
+  // keeps calling us
+  SetSharedInterferenceLedger (false);
+  for (uint32_t j = 0; j < m_phyMobility.size (); j++)
+    {
+      UnwatchMobility (j);
+    }
+
   m_phyList.clear ();
 }
 
 LoraChannel::LoraChannel (Ptr<PropagationLossModel> loss,
                           Ptr<PropagationDelayModel> delay) :
   m_loss (loss),
-  m_delay (delay)
+  m_delay (delay),
+  m_sharedLedger (false),
+  m_linkBudgetCache (false),
+  m_tableValid (false),
+  m_frequencySubscriptions (false),
+  m_iqPolarityFiltering (false),
+  m_fanOutDelivery (false),
+  m_fanOutDelayResolution (Seconds (0)),
+  m_receiverCulling (false),
+  m_cullingMarginDb (20),
+  m_gridValid (false),
+  m_gridCellSize (0),
+  m_minSensitivity (0)
 {
+  m_pathLoss = GetPathLossParameters (m_loss);
 }
 
 void
@@ -83,6 +212,26 @@ LoraChannel::Add (Ptr<LoraPhy> phy)
 
   // Add the new phy to the vector
   m_phyList.push_back (phy);
+  m_phyIndex[PeekPointer (phy)] = m_phyList.size () - 1;
+  m_ledgerIds.push_back (m_ledger.AddReceiver ());
+  m_phyMobility.push_back (0);
+  m_phyPositions.push_back (Vector ());
+  m_phyMobile.push_back (0);
+  m_phyContexts.push_back (0);
+  m_phyInvertedIq.push_back (0);
+  m_phyFrequencies.push_back (std::vector<double> ());
+  m_gridValid = false;
+  m_tableValid = false;
+
+  if (m_frequencySubscriptions)
+    {
+      Subscribe (m_phyList.size () - 1);
+    }
+
+  if (m_sharedLedger)
+    {
+      phy->SetInterferenceLedger (&m_ledger, m_ledgerIds.back ());
+    }
 }
 
 void
@@ -91,7 +240,469 @@ LoraChannel::Remove (Ptr<LoraPhy> phy)
   NS_LOG_FUNCTION (this << phy);
 
   // Remove the phy from the vector
-  m_phyList.erase (find (m_phyList.begin (), m_phyList.end (), phy));
+  std::vector<Ptr<LoraPhy> >::iterator it = find (m_phyList.begin (),
+                                                  m_phyList.end (), phy);
+  uint32_t j = it - m_phyList.begin ();
+  UnwatchMobility (j);
+  m_phyMobility.erase (m_phyMobility.begin () + j);
+  m_phyPositions.erase (m_phyPositions.begin () + j);
+  m_phyMobile.erase (m_phyMobile.begin () + j);
+  m_phyContexts.erase (m_phyContexts.begin () + j);
+  m_phyInvertedIq.erase (m_phyInvertedIq.begin () + j);
+  m_ledgerIds.erase (m_ledgerIds.begin () + j);
+  m_phyFrequencies.erase (m_phyFrequencies.begin () + j);
+  m_phyList.erase (it);
+  m_gridValid = false;
+  m_tableValid = false;
+
+  m_phyIndex.erase (PeekPointer (phy));
+  for (; j < m_phyList.size (); j++)
+    {
+      m_phyIndex[PeekPointer (m_phyList[j])] = j;
+    }
+
+  // The following PHYs moved up by one row
+  m_mobilityIndex.clear ();
+  for (uint32_t k = 0; k < m_phyMobility.size (); k++)
+    {
+      if (m_phyMobility[k] != 0)
+        {
+          m_mobilityIndex.insert (std::make_pair (PeekPointer (m_phyMobility[k]), k));
+        }
+    }
+
+  // Indexes of the following PHYs changed
+  if (m_frequencySubscriptions)
+    {
+      RebuildSubscriptions ();
+    }
+
+  if (m_sharedLedger)
+    {
+      phy->SetInterferenceLedger (0, 0);
+    }
+}
+
+void
+LoraChannel::SetSharedInterferenceLedger (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+
+  if (enable == m_sharedLedger)
+    {
+      return;
+    }
+
+  m_sharedLedger = enable;
+  m_ledger.ClearAllEvents ();
+
+  for (uint32_t j = 0; j < m_phyList.size (); j++)
+    {
+      m_phyList[j]->SetInterferenceLedger (enable ? &m_ledger : 0,
+                                           m_ledgerIds[j]);
+    }
+}
+
+bool
+LoraChannel::GetSharedInterferenceLedger (void) const
+{
+  return m_sharedLedger;
+}
+
+void
+LoraChannel::SetOldEventThreshold (Time threshold)
+{
+  NS_LOG_FUNCTION (this << threshold);
+
+  m_ledger.SetOldEventThreshold (threshold);
+}
+
+Time
+LoraChannel::GetOldEventThreshold (void) const
+{
+  return m_ledger.GetOldEventThreshold ();
+}
+
+void
+LoraChannel::SetFrequencySubscriptions (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+
+  m_frequencySubscriptions = enable;
+  RebuildSubscriptions ();
+}
+
+bool
+LoraChannel::GetFrequencySubscriptions (void) const
+{
+  return m_frequencySubscriptions;
+}
+
+void
+LoraChannel::UpdateFrequencySubscription (Ptr<LoraPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+
+  if (!m_frequencySubscriptions)
+    {
+      return;
+    }
+
+  std::unordered_map<const LoraPhy *, uint32_t>::const_iterator it =
+    m_phyIndex.find (PeekPointer (phy));
+  if (it == m_phyIndex.end ())
+    {
+      return;
+    }
+  uint32_t j = it->second;
+
+  // Remove the old subscriptions
+  for (std::vector<double>::const_iterator f = m_phyFrequencies[j].begin ();
+       f != m_phyFrequencies[j].end (); f++)
+    {
+      std::vector<uint32_t> &subscribers = m_subscribers[*f];
+      subscribers.erase (std::lower_bound (subscribers.begin (),
+                                           subscribers.end (), j));
+    }
+
+  Subscribe (j);
+}
+
+void
+LoraChannel::Subscribe (uint32_t j)
+{
+  m_phyFrequencies[j] = m_phyList[j]->GetListeningFrequencies ();
+  for (std::vector<double>::const_iterator f = m_phyFrequencies[j].begin ();
+       f != m_phyFrequencies[j].end (); f++)
+    {
+      std::vector<uint32_t> &subscribers = m_subscribers[*f];
+      subscribers.insert (std::lower_bound (subscribers.begin (),
+                                            subscribers.end (), j), j);
+    }
+}
+
+void
+LoraChannel::RebuildSubscriptions (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_subscribers.clear ();
+  for (uint32_t j = 0; j < m_phyList.size (); j++)
+    {
+      if (m_frequencySubscriptions)
+        {
+          Subscribe (j);
+        }
+      else
+        {
+          m_phyFrequencies[j].clear ();
+        }
+    }
+}
+
+void
+LoraChannel::SetLinkBudgetCache (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+
+  m_linkBudgetCache = enable;
+  m_linkBudgets.clear ();
+}
+
+bool
+LoraChannel::GetLinkBudgetCache (void) const
+{
+  return m_linkBudgetCache;
+}
+
+std::set<std::string> &
+LoraChannel::GetDeterministicModels (void)
+{
+  // Models whose loss only depends on the positions of the two nodes. Models
+  // like FixedRss and Range, whose output is not an attenuation of the
+  // transmission power, cannot be cached.
+  static std::set<std::string> models = {
+    "ns3::FriisPropagationLossModel",
+    "ns3::TwoRayGroundPropagationLossModel",
+    "ns3::LogDistancePropagationLossModel",
+    "ns3::ThreeLogDistancePropagationLossModel",
+    "ns3::MatrixPropagationLossModel",
+    CorrelatedShadowingPropagationLossModel::GetTypeId ().GetName (),
+    "ns3::ConstantSpeedPropagationDelayModel"};
+  return models;
+}
+
+void
+LoraChannel::DeclareDeterministic (TypeId tid)
+{
+  NS_LOG_FUNCTION (tid);
+
+  GetDeterministicModels ().insert (tid.GetName ());
+}
+
+bool
+LoraChannel::IsDeterministic (Ptr<PropagationLossModel> loss)
+{
+  const std::set<std::string> &models = GetDeterministicModels ();
+  for (Ptr<PropagationLossModel> model = loss; model != 0; model = model->GetNext ())
+    {
+      // Building penetration losses can be fixed for each link
+      Ptr<BuildingPenetrationLoss> building = DynamicCast<BuildingPenetrationLoss> (model);
+      if (building != 0 && building->IsFixedPerLink ())
+        {
+          continue;
+        }
+      if (models.find (model->GetInstanceTypeId ().GetName ()) == models.end ())
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+LoraChannel::IsDeterministic (Ptr<PropagationDelayModel> delay)
+{
+  const std::set<std::string> &models = GetDeterministicModels ();
+  return models.find (delay->GetInstanceTypeId ().GetName ()) != models.end ();
+}
+
+void
+LoraChannel::CourseChanged (Ptr<const MobilityModel> mobility) const
+{
+  NS_LOG_FUNCTION (this << mobility);
+
+  // The whole table is read again on the next transmission anyway
+  if (!m_tableValid)
+    {
+      return;
+    }
+
+  typedef std::unordered_multimap<const MobilityModel *, uint32_t>::const_iterator Iterator;
+  std::pair<Iterator, Iterator> range = m_mobilityIndex.equal_range (PeekPointer (mobility));
+  for (Iterator it = range.first; it != range.second; ++it)
+    {
+      UpdatePosition (it->second);
+    }
+}
+
+void
+LoraChannel::UpdatePosition (uint32_t j) const
+{
+  NS_LOG_FUNCTION (this << j);
+
+  Vector oldPosition = m_phyPositions[j];
+  Vector newPosition = m_phyMobility[j]->GetPosition ();
+  m_phyPositions[j] = newPosition;
+
+  // Mobile PHYs are kept out of the grid
+  if (m_gridValid && !m_phyMobile[j])
+    {
+      uint64_t oldKey = GetCellKey (oldPosition.x, oldPosition.y);
+      uint64_t newKey = GetCellKey (newPosition.x, newPosition.y);
+      if (oldKey != newKey)
+        {
+          std::vector<uint32_t> &oldCell = m_grid[oldKey];
+          oldCell.erase (std::find (oldCell.begin (), oldCell.end (), j));
+          if (oldCell.empty ())
+            {
+              m_grid.erase (oldKey);
+            }
+          m_grid[newKey].push_back (j);
+        }
+    }
+
+  // Drop the links this PHY is at either end of
+  if (!m_linkBudgets.empty ())
+    {
+      uint64_t id = m_ledgerIds[j];
+      for (uint32_t k = 0; k < m_ledgerIds.size (); k++)
+        {
+          uint64_t other = m_ledgerIds[k];
+          m_linkBudgets.erase ((id << 32) | other);
+          m_linkBudgets.erase ((other << 32) | id);
+        }
+    }
+}
+
+void
+LoraChannel::InvalidateReceiverTable (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_linkBudgets.clear ();
+  m_gridValid = false;
+  m_tableValid = false;
+}
+
+void
+LoraChannel::RefreshReceiverTable (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  for (uint32_t j = 0; j < m_phyList.size (); j++)
+    {
+      Ptr<MobilityModel> mobility = m_phyList[j]->GetMobility ()->
+        GetObject<MobilityModel> ();
+      WatchMobility (j, mobility);
+      m_phyPositions[j] = mobility->GetPosition ();
+
+      // Other models can move without firing CourseChange, so their
+      // position must be read again every time it's needed
+      m_phyMobile[j] = DynamicCast<ConstantPositionMobilityModel> (mobility) == 0;
+
+      // PHYs without a net device use context 0
+      Ptr<NetDevice> device = m_phyList[j]->GetDevice ();
+      m_phyContexts[j] = device != 0 ? device->GetNode ()->GetId () : 0;
+
+      m_phyInvertedIq[j] = m_phyList[j]->IsListeningInvertedIq ();
+    }
+  m_tableValid = true;
+}
+
+void
+LoraChannel::WatchMobility (uint32_t i, Ptr<MobilityModel> mobility) const
+{
+  if (m_phyMobility[i] == mobility)
+    {
+      return;
+    }
+
+  UnwatchMobility (i);
+  mobility->TraceConnectWithoutContext ("CourseChange",
+                                        MakeCallback (&LoraChannel::CourseChanged,
+                                                      this));
+  m_phyMobility[i] = mobility;
+  m_mobilityIndex.insert (std::make_pair (PeekPointer (mobility), i));
+}
+
+double
+LoraChannel::GetMaxRange (double txPowerDbm) const
+{
+  if (!m_pathLoss.valid || m_phyList.empty ())
+    {
+      return std::numeric_limits<double>::infinity ();
+    }
+
+  if (!m_gridValid)
+    {
+      m_minSensitivity = std::numeric_limits<double>::infinity ();
+      for (std::vector<Ptr<LoraPhy> >::const_iterator i = m_phyList.begin ();
+           i != m_phyList.end (); i++)
+        {
+          m_minSensitivity = std::min (m_minSensitivity, (*i)->GetMinSensitivity ());
+        }
+    }
+
+  // Invert L = L0 + 10 n log10 (d / d0)
+  double maxLossDb = txPowerDbm - m_minSensitivity + m_cullingMarginDb;
+  return m_pathLoss.referenceDistance *
+         std::pow (10, (maxLossDb - m_pathLoss.referenceLoss) / (10 * m_pathLoss.exponent));
+}
+
+uint64_t
+LoraChannel::GetCellKey (double x, double y) const
+{
+  int32_t ix = int32_t (std::floor (x / m_gridCellSize));
+  int32_t iy = int32_t (std::floor (y / m_gridCellSize));
+  return (uint64_t (uint32_t (ix)) << 32) | uint32_t (iy);
+}
+
+void
+LoraChannel::BuildGrid (double cellSize) const
+{
+  NS_LOG_FUNCTION (this << cellSize);
+
+  m_grid.clear ();
+  m_mobilePhys.clear ();
+  m_gridCellSize = cellSize;
+  for (uint32_t j = 0; j < m_phyList.size (); j++)
+    {
+      if (m_phyMobile[j])
+        {
+          m_mobilePhys.push_back (j);
+          continue;
+        }
+      const Vector &position = m_phyPositions[j];
+      m_grid[GetCellKey (position.x, position.y)].push_back (j);
+    }
+  m_gridValid = true;
+}
+
+void
+LoraChannel::GetPhysInRange (Vector position, double range,
+                             std::vector<uint32_t> &candidates) const
+{
+  int64_t minX = int64_t (std::floor ((position.x - range) / m_gridCellSize));
+  int64_t maxX = int64_t (std::floor ((position.x + range) / m_gridCellSize));
+  int64_t minY = int64_t (std::floor ((position.y - range) / m_gridCellSize));
+  int64_t maxY = int64_t (std::floor ((position.y + range) / m_gridCellSize));
+
+  // Visit the cells overlapping the square around the point, unless there
+  // are fewer non-empty cells than that
+  if (double (maxX - minX + 1) * double (maxY - minY + 1) < m_grid.size ())
+    {
+      for (int64_t x = minX; x <= maxX; x++)
+        {
+          for (int64_t y = minY; y <= maxY; y++)
+            {
+              uint64_t key = (uint64_t (uint32_t (x)) << 32) | uint32_t (y);
+              std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell =
+                m_grid.find (key);
+              if (cell != m_grid.end ())
+                {
+                  candidates.insert (candidates.end (), cell->second.begin (),
+                                     cell->second.end ());
+                }
+            }
+        }
+    }
+  else
+    {
+      for (std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell =
+             m_grid.begin (); cell != m_grid.end (); cell++)
+        {
+          candidates.insert (candidates.end (), cell->second.begin (),
+                             cell->second.end ());
+        }
+    }
+
+  candidates.insert (candidates.end (), m_mobilePhys.begin (), m_mobilePhys.end ());
+
+  // Keep the PHYs within range, in the same order as m_phyList so that
+  // receptions are scheduled in the same order. Random models in the loss
+  // chain still draw different values, since culled links are skipped.
+  std::vector<uint32_t>::iterator last =
+    std::remove_if (candidates.begin (), candidates.end (),
+                    [this, &position, range] (uint32_t j) {
+                      Vector phyPosition = m_phyMobile[j] ? m_phyMobility[j]->GetPosition ()
+                                                          : m_phyPositions[j];
+                      return CalculateDistance (position, phyPosition) > range;
+                    });
+  candidates.erase (last, candidates.end ());
+  std::sort (candidates.begin (), candidates.end ());
+}
+
+void
+LoraChannel::UnwatchMobility (uint32_t i) const
+{
+  if (m_phyMobility[i] != 0)
+    {
+      m_phyMobility[i]->TraceDisconnectWithoutContext
+        ("CourseChange", MakeCallback (&LoraChannel::CourseChanged, this));
+      typedef std::unordered_multimap<const MobilityModel *, uint32_t>::iterator Iterator;
+      std::pair<Iterator, Iterator> range =
+        m_mobilityIndex.equal_range (PeekPointer (m_phyMobility[i]));
+      for (Iterator it = range.first; it != range.second; ++it)
+        {
+          if (it->second == i)
+            {
+              m_mobilityIndex.erase (it);
+              break;
+            }
+        }
+      m_phyMobility[i] = 0;
+    }
 }
 
 std::size_t
@@ -119,66 +730,293 @@ LoraChannel::Send (Ptr< LoraPhy > sender, Ptr< Packet > packet,
 
   NS_ASSERT (senderMobility != 0);     // Make sure it's available
 
+  if (!m_tableValid)
+    {
+      RefreshReceiverTable ();
+    }
+
+  // Record the transmission once, each receiver will only add its power
+  Ptr<LoraInterferenceHelper::Event> transmission = 0;
+  if (m_sharedLedger)
+    {
+      transmission = m_ledger.AddTransmission (duration, txParams.sf, packet,
+                                               frequencyMHz);
+    }
+
+  // See which parts of the link budget can be reused. The sender needs to
+  // be connected to the channel to identify its links.
+  bool cacheRxPower = false;
+  bool cacheDelay = false;
+  uint64_t senderKey = 0;
+  if (m_linkBudgetCache)
+    {
+      std::unordered_map<const LoraPhy *, uint32_t>::const_iterator senderIt =
+        m_phyIndex.find (PeekPointer (sender));
+      if (senderIt != m_phyIndex.end ())
+        {
+          uint32_t senderIndex = senderIt->second;
+          senderKey = uint64_t (m_ledgerIds[senderIndex]) << 32;
+          // The links of a mobile sender can change at any time
+          bool senderStatic = !m_phyMobile[senderIndex];
+          cacheRxPower = senderStatic && IsDeterministic (m_loss);
+          cacheDelay = senderStatic && IsDeterministic (m_delay);
+        }
+    }
+
+  // Only consider the PHYs that are close enough to be affected by this
+  // transmission, if we can tell which ones they are
+  std::vector<uint32_t> candidates;
+  bool filtered = false;
+  if (m_receiverCulling)
+    {
+      double range = GetMaxRange (txPowerDbm);
+      if (range < std::numeric_limits<double>::infinity ())
+        {
+          if (!m_gridValid)
+            {
+              BuildGrid (range);
+            }
+          GetPhysInRange (senderMobility->GetPosition (), range, candidates);
+          filtered = true;
+          NS_LOG_DEBUG (candidates.size () << " PHYs within " << range << " m");
+        }
+    }
+
+  // Only consider the PHYs that are listening on this frequency
+  if (m_frequencySubscriptions)
+    {
+      std::map<double, std::vector<uint32_t> >::const_iterator subscribers =
+        m_subscribers.find (frequencyMHz);
+      if (filtered)
+        {
+          // Both lists are sorted
+          std::vector<uint32_t> subscribed;
+          if (subscribers != m_subscribers.end ())
+            {
+              std::set_intersection (candidates.begin (), candidates.end (),
+                                     subscribers->second.begin (),
+                                     subscribers->second.end (),
+                                     std::back_inserter (subscribed));
+            }
+          candidates.swap (subscribed);
+        }
+      else if (subscribers != m_subscribers.end ())
+        {
+          candidates = subscribers->second;
+        }
+      filtered = true;
+      NS_LOG_DEBUG (candidates.size () << " PHYs listening on " << frequencyMHz << " MHz");
+    }
+
+  // With fan-out delivery, receptions are collected and scheduled at the end
+  Ptr<FanOut> fanOut = 0;
+  if (m_fanOutDelivery)
+    {
+      fanOut = Create<FanOut> ();
+      fanOut->packet = packet;
+      fanOut->parameters.sf = txParams.sf;
+      fanOut->parameters.duration = duration;
+      fanOut->parameters.frequencyMHz = frequencyMHz;
+      fanOut->parameters.bandwidthHz = txParams.bandwidthHz;
+      fanOut->parameters.invertedIq = txParams.invertedIq;
+    }
+
   NS_LOG_INFO ("Starting cycle over all " << m_phyList.size () << " PHYs");
   NS_LOG_INFO ("Sender mobility: " << senderMobility->GetPosition ());
 
-  // Cycle over all registered PHYs
-  uint32_t j = 0;
-  std::vector<Ptr<LoraPhy> >::const_iterator i;
-  for (i = m_phyList.begin (); i != m_phyList.end (); i++, j++)
+  // Collect the PHYs that will be delivered the transmission
+  std::vector<uint32_t> &receivers = m_batchPhys;
+  receivers.clear ();
+  uint32_t nPhys = filtered ? candidates.size () : m_phyList.size ();
+  for (uint32_t k = 0; k < nPhys; k++)
     {
-      // Do not deliver to the sender (*i is the current PHY)
-      if (sender != (*i))
+      uint32_t j = filtered ? candidates[k] : k;
+
+      // Skip PHYs that cannot demodulate, nor be interfered by, signals with
+      // this IQ polarity
+      if (m_iqPolarityFiltering &&
+          bool (m_phyInvertedIq[j]) != txParams.invertedIq)
+        {
+          continue;
+        }
+
+      // Do not deliver to the sender
+      if (m_phyList[j] != sender)
         {
-          // Get the receiver's mobility model
-          Ptr<MobilityModel> receiverMobility = (*i)->GetMobility ()->
-            GetObject<MobilityModel> ();
+          receivers.push_back (j);
+        }
+    }
+
+  // Compute, in a single batch, the received power at the PHYs whose link
+  // budget is not cached. The positions of static PHYs come from the table.
+  std::vector<Ptr<MobilityModel> > &batchMobility = m_batchMobility;
+  std::vector<Vector> &batchPositions = m_batchPositions;
+  batchMobility.clear ();
+  batchPositions.clear ();
+  for (std::vector<uint32_t>::const_iterator j = receivers.begin ();
+       j != receivers.end (); ++j)
+    {
+      if (cacheRxPower && !m_phyMobile[*j])
+        {
+          std::unordered_map<uint64_t, LinkBudget>::const_iterator budget =
+            m_linkBudgets.find (senderKey | m_ledgerIds[*j]);
+          if (budget != m_linkBudgets.end () && budget->second.hasRxPower)
+            {
+              continue;
+            }
+        }
+      batchMobility.push_back (m_phyMobility[*j]);
+      batchPositions.push_back (m_phyMobile[*j] ? m_phyMobility[*j]->GetPosition ()
+                                                : m_phyPositions[*j]);
+    }
+  std::vector<double> &batchRxPowerDbm = m_batchRxPowerDbm;
+  batchRxPowerDbm.resize (batchMobility.size ());
+  if (!batchMobility.empty ())
+    {
+      DoCalcRxPowerBatch (m_pathLoss, m_loss, txPowerDbm, senderMobility,
+                          &batchMobility[0], &batchPositions[0],
+                          batchMobility.size (), &batchRxPowerDbm[0]);
+    }
+  // Release the references to the mobility models
+  batchMobility.clear ();
+  std::size_t nextBatchResult = 0;
 
-          NS_LOG_INFO ("Receiver mobility: " <<
-                       receiverMobility->GetPosition ());
+  // Cycle over all receiving PHYs
+  for (std::vector<uint32_t>::const_iterator r = receivers.begin ();
+       r != receivers.end (); ++r)
+    {
+      uint32_t j = *r;
 
-          // Compute delay using the delay model
-          Time delay = m_delay->GetDelay (senderMobility, receiverMobility);
+      // Get the receiver's mobility model
+      const Ptr<MobilityModel> &receiverMobility = m_phyMobility[j];
 
-          // Compute received power using the loss model
-          double rxPowerDbm = GetRxPower (txPowerDbm, senderMobility,
-                                          receiverMobility);
+      NS_LOG_INFO ("Receiver mobility: " << receiverMobility->GetPosition ());
 
-          NS_LOG_DEBUG ("Propagation: txPower=" << txPowerDbm <<
-                        "dbm, rxPower=" << rxPowerDbm << "dbm, " <<
-                        "distance=" << senderMobility->GetDistanceFrom (receiverMobility) <<
-                        "m, delay=" << delay);
+      LinkBudget *budget = 0;
+      if ((cacheRxPower || cacheDelay) && !m_phyMobile[j])
+        {
+          LinkBudget &entry = m_linkBudgets[senderKey | m_ledgerIds[j]];
+          budget = &entry;
+        }
+
+      // Compute delay using the delay model
+      Time delay;
+      if (budget != 0 && budget->hasDelay)
+        {
+          delay = budget->delay;
+        }
+      else
+        {
+          delay = m_delay->GetDelay (senderMobility, receiverMobility);
+          if (cacheDelay && budget != 0)
+            {
+              budget->delay = delay;
+              budget->hasDelay = true;
+            }
+        }
 
-          // Get the id of the destination PHY to correctly format the context
-          Ptr<NetDevice> dstNetDevice = m_phyList[j]->GetDevice ();
-          uint32_t dstNode = 0;
-          if (dstNetDevice != 0)
+      // Get the received power computed by the loss model. Since cached
+      // models attenuate the transmission power by a fixed amount, the
+      // cached result can be shifted if the transmission power changed.
+      double rxPowerDbm;
+      if (budget != 0 && budget->hasRxPower)
+        {
+          rxPowerDbm = budget->rxPowerDbm;
+          if (budget->txPowerDbm != txPowerDbm)
             {
-              NS_LOG_INFO ("Getting node index from NetDevice, since it exists");
-              dstNode = dstNetDevice->GetNode ()->GetId ();
-              NS_LOG_DEBUG ("dstNode = " << dstNode);
+              rxPowerDbm += txPowerDbm - budget->txPowerDbm;
             }
-          else
+        }
+      else
+        {
+          rxPowerDbm = batchRxPowerDbm[nextBatchResult++];
+          if (cacheRxPower && budget != 0)
             {
-              NS_LOG_INFO ("No net device connected to the PHY, using context 0");
+              budget->txPowerDbm = txPowerDbm;
+              budget->rxPowerDbm = rxPowerDbm;
+              budget->hasRxPower = true;
             }
+        }
 
-          // Create the parameters object based on the calculations above
-          LoraChannelParameters parameters;
-          parameters.rxPowerDbm = rxPowerDbm;
-          parameters.sf = txParams.sf;
-          parameters.duration = duration;
-          parameters.frequencyMHz = frequencyMHz;
+      NS_LOG_DEBUG ("Propagation: txPower=" << txPowerDbm <<
+                    "dbm, rxPower=" << rxPowerDbm << "dbm, " <<
+                    "distance=" << senderMobility->GetDistanceFrom (receiverMobility) <<
+                    "m, delay=" << delay);
 
-          // Schedule the receive event
-          NS_LOG_INFO ("Scheduling reception of the packet");
-          Simulator::ScheduleWithContext (dstNode, delay, &LoraChannel::Receive,
-                                          this, j, packet, parameters);
+      if (transmission != 0)
+        {
+          transmission->SetRxPowerdBm (m_ledgerIds[j], rxPowerDbm);
+        }
 
-          // Fire the trace source for sent packet
+      // Get the id of the destination node to correctly format the context
+      uint32_t dstNode = m_phyContexts[j];
+      NS_LOG_DEBUG ("dstNode = " << dstNode);
+
+      if (fanOut != 0)
+        {
+          if (m_fanOutDelayResolution.IsStrictlyPositive ())
+            {
+              int64_t resolution = m_fanOutDelayResolution.GetTimeStep ();
+              delay = TimeStep ((delay.GetTimeStep () / resolution) * resolution);
+            }
+          Delivery delivery = {j, dstNode, rxPowerDbm, delay};
+          fanOut->deliveries.push_back (delivery);
           m_packetSent (packet);
+          continue;
         }
+
+      // Create the parameters object based on the calculations above
+      LoraChannelParameters parameters;
+      parameters.rxPowerDbm = rxPowerDbm;
+      parameters.sf = txParams.sf;
+      parameters.duration = duration;
+      parameters.frequencyMHz = frequencyMHz;
+      parameters.bandwidthHz = txParams.bandwidthHz;
+      parameters.invertedIq = txParams.invertedIq;
+
+      // Schedule the receive event
+      NS_LOG_INFO ("Scheduling reception of the packet");
+      Simulator::ScheduleWithContext (dstNode, delay, &LoraChannel::Receive,
+                                      this, j, packet, parameters);
+
+      // Fire the trace source for sent packet
+      m_packetSent (packet);
+    }
+
+  if (fanOut != 0 && !fanOut->deliveries.empty ())
+    {
+      // Receivers with the same delay keep the order they had in m_phyList
+      std::stable_sort (fanOut->deliveries.begin (), fanOut->deliveries.end (),
+                        [] (const Delivery &a, const Delivery &b) {
+                          return a.delay < b.delay;
+                        });
+      const Delivery &first = fanOut->deliveries.front ();
+      Simulator::ScheduleWithContext (first.context, first.delay,
+                                      &LoraChannel::DeliverFanOut, this,
+                                      fanOut, 0);
+    }
+}
+
+void
+LoraChannel::DeliverFanOut (Ptr<FanOut> fanOut, uint32_t k) const
+{
+  NS_LOG_FUNCTION (this << fanOut->packet << k);
+
+  const Delivery &delivery = fanOut->deliveries[k];
+
+  // Schedule the next reception first, so that receptions at the same time
+  // happen before any event they trigger
+  if (k + 1 < fanOut->deliveries.size ())
+    {
+      const Delivery &next = fanOut->deliveries[k + 1];
+      Simulator::ScheduleWithContext (next.context, next.delay - delivery.delay,
+                                      &LoraChannel::DeliverFanOut, this,
+                                      fanOut, k + 1);
     }
+
+  LoraChannelParameters parameters = fanOut->parameters;
+  parameters.rxPowerDbm = delivery.rxPowerDbm;
+  Receive (delivery.i, fanOut->packet, parameters);
 }
 
 void
@@ -189,14 +1027,20 @@ LoraChannel::Receive (uint32_t i, Ptr<Packet> packet,
 
   // Call the appropriate PHY instance to let it begin reception
   m_phyList[i]->StartReceive (packet, parameters.rxPowerDbm, parameters.sf,
-                              parameters.duration, parameters.frequencyMHz);
+                              parameters.duration, parameters.frequencyMHz,
+                              parameters.bandwidthHz);
 }
 
 void
 LoraChannel::InterruptTx (Ptr<LoraPhy> sender, Ptr<Packet> packet, Time realDuration)
 {
   NS_LOG_FUNCTION (this << packet << realDuration);
-    
+
+  if (m_sharedLedger)
+    {
+      m_ledger.ModifyEvent (packet, realDuration);
+    }
+
   uint32_t j = 0;
   std::vector<Ptr<LoraPhy>>::const_iterator i;
   for (i = m_phyList.begin (); i != m_phyList.end (); i++, j++)
@@ -216,11 +1060,137 @@ LoraChannel::GetRxPower (double txPowerDbm, Ptr<MobilityModel> senderMobility,
   return m_loss->CalcRxPower (txPowerDbm, senderMobility, receiverMobility);
 }
 
+void
+LoraChannel::GetRxPowers (double txPowerDbm, Ptr<MobilityModel> senderMobility,
+                          const std::vector<Ptr<MobilityModel> > &receiverMobility,
+                          std::vector<double> &rxPowerDbm) const
+{
+  rxPowerDbm.resize (receiverMobility.size ());
+  if (receiverMobility.empty ())
+    {
+      return;
+    }
+
+  std::vector<Vector> positions;
+  if (m_pathLoss.valid)
+    {
+      positions.reserve (receiverMobility.size ());
+      for (std::size_t k = 0; k < receiverMobility.size (); k++)
+        {
+          positions.push_back (receiverMobility[k]->GetPosition ());
+        }
+    }
+  DoCalcRxPowerBatch (m_pathLoss, m_loss, txPowerDbm, senderMobility,
+                      &receiverMobility[0], positions.empty () ? 0 : &positions[0],
+                      receiverMobility.size (), &rxPowerDbm[0]);
+}
+
+LoraChannel::PathLossParameters
+LoraChannel::GetPathLossParameters (Ptr<PropagationLossModel> loss)
+{
+  PathLossParameters pathLoss;
+
+  // Subclasses may override the computation, so they are not matched
+  if (loss == 0 ||
+      loss->GetInstanceTypeId () != LogDistancePropagationLossModel::GetTypeId ())
+    {
+      return pathLoss;
+    }
+
+  DoubleValue exponent;
+  DoubleValue referenceDistance;
+  DoubleValue referenceLoss;
+  loss->GetAttribute ("Exponent", exponent);
+  loss->GetAttribute ("ReferenceDistance", referenceDistance);
+  loss->GetAttribute ("ReferenceLoss", referenceLoss);
+  pathLoss.valid = true;
+  pathLoss.exponent = exponent.Get ();
+  pathLoss.referenceDistance = referenceDistance.Get ();
+  pathLoss.referenceLoss = referenceLoss.Get ();
+  return pathLoss;
+}
+
+void
+LoraChannel::CalcRxPowerBatch (Ptr<PropagationLossModel> loss,
+                               double txPowerDbm, Ptr<MobilityModel> sender,
+                               const Ptr<MobilityModel> *receivers,
+                               std::size_t n, double *rxPowerDbm)
+{
+  NS_LOG_FUNCTION (loss << txPowerDbm << sender << n);
+
+  PathLossParameters pathLoss = GetPathLossParameters (loss);
+  std::vector<Vector> positions;
+  if (pathLoss.valid)
+    {
+      positions.reserve (n);
+      for (std::size_t k = 0; k < n; k++)
+        {
+          positions.push_back (receivers[k]->GetPosition ());
+        }
+    }
+  DoCalcRxPowerBatch (pathLoss, loss, txPowerDbm, sender, receivers,
+                      positions.empty () ? 0 : &positions[0], n, rxPowerDbm);
+}
+
+void
+LoraChannel::DoCalcRxPowerBatch (const PathLossParameters &pathLoss,
+                                 Ptr<PropagationLossModel> loss,
+                                 double txPowerDbm, Ptr<MobilityModel> sender,
+                                 const Ptr<MobilityModel> *receivers,
+                                 const Vector *positions,
+                                 std::size_t n, double *rxPowerDbm)
+{
+  // Fall back to computing one link at a time
+  if (!pathLoss.valid)
+    {
+      for (std::size_t k = 0; k < n; k++)
+        {
+          rxPowerDbm[k] = loss->CalcRxPower (txPowerDbm, sender, receivers[k]);
+        }
+      return;
+    }
+
+  // Write the distances to the output array, then turn them into received
+  // powers in place. Both loops run over contiguous arrays without virtual
+  // calls; the second one calls std::log10 per element, so it is only
+  // vectorized where the compiler has a vector log10.
+  const Vector senderPosition = sender->GetPosition ();
+  for (std::size_t k = 0; k < n; k++)
+    {
+      rxPowerDbm[k] = CalculateDistance (senderPosition, positions[k]);
+    }
+  const double exponent = pathLoss.exponent;
+  const double referenceDistance = pathLoss.referenceDistance;
+  const double referenceLoss = pathLoss.referenceLoss;
+  for (std::size_t k = 0; k < n; k++)
+    {
+      const double distance = rxPowerDbm[k];
+      const double pathLossDb = 10 * exponent *
+        std::log10 (distance / referenceDistance);
+      rxPowerDbm[k] = distance <= referenceDistance ?
+        txPowerDbm - referenceLoss :
+        txPowerDbm + (-referenceLoss - pathLossDb);
+    }
+
+  // Apply the rest of the chain to each link
+  Ptr<PropagationLossModel> next = loss->GetNext ();
+  if (next != 0)
+    {
+      for (std::size_t k = 0; k < n; k++)
+        {
+          rxPowerDbm[k] = next->CalcRxPower (rxPowerDbm[k], sender,
+                                             receivers[k]);
+        }
+    }
+}
+
 std::ostream &operator << (std::ostream &os, const LoraChannelParameters &params)
 {
   os << "(rxPowerDbm: " << params.rxPowerDbm << ", SF: " << unsigned(params.sf) <<
     ", durationSec: " << params.duration.GetSeconds () <<
-    ", frequencyMHz: " << params.frequencyMHz << ")";
+    ", frequencyMHz: " << params.frequencyMHz <<
+    ", bandwidthHz: " << params.bandwidthHz <<
+    ", invertedIq: " << params.invertedIq << ")";
   return os;
 }
 }
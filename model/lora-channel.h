@@ -25,6 +25,10 @@
 #define LORA_CHANNEL_H
 
 #include <vector>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <map>
 #include "ns3/lora-phy.h"
 #include "ns3/mobility-model.h"
 #include "ns3/channel.h"
@@ -34,6 +38,7 @@
 #include "ns3/logical-lora-channel.h"
 #include "ns3/packet.h"
 #include "ns3/nstime.h"
+#include "ns3/lora-interference-helper.h"
 
 namespace ns3 {
 class NetDevice;
@@ -54,6 +59,8 @@ struct LoraChannelParameters
   uint8_t sf;     //!< The Spreading Factor of this transmission.
   Time duration;     //!< The duration of the transmission.
   double frequencyMHz;     //!< The frequency [MHz] of this transmission.
+  double bandwidthHz;     //!< The bandwidth [Hz] of this transmission.
+  bool invertedIq;     //!< Whether this transmission uses inverted IQ.
 };
 
 /**
@@ -93,6 +100,22 @@ public:
   LoraChannel (Ptr<PropagationLossModel> loss,
                Ptr<PropagationDelayModel> delay);
 
+  /**
+   * Set the propagation loss model chain of this channel.
+   *
+   * If the chain starts with a LogDistancePropagationLossModel, its
+   * parameters are read here and reused by every transmission, so they
+   * should not be changed after the model is set.
+   *
+   * \param loss The first model of the chain.
+   */
+  void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+  /**
+   * Get the propagation loss model chain of this channel.
+   */
+  Ptr<PropagationLossModel> GetPropagationLossModel (void) const;
+
   /**
     * Connect a LoraPhy object to the LoraChannel.
     *
@@ -153,12 +176,302 @@ public:
   double GetRxPower (double txPowerDbm, Ptr<MobilityModel> senderMobility,
                      Ptr<MobilityModel> receiverMobility) const;
 
+  /**
+   * Compute the power a transmission is received with by several receivers
+   * using this Channel's PropagationLossModel.
+   *
+   * This is equivalent to calling GetRxPower for each receiver, in order.
+   *
+   * \param txPowerDbm The power the transmitter is using, in dBm.
+   * \param senderMobility The mobility model of the sender.
+   * \param receiverMobility The mobility models of the receivers.
+   * \param rxPowerDbm The vector the received powers are written to, in dBm.
+   */
+  void GetRxPowers (double txPowerDbm, Ptr<MobilityModel> senderMobility,
+                    const std::vector<Ptr<MobilityModel> > &receiverMobility,
+                    std::vector<double> &rxPowerDbm) const;
+
+  /**
+   * Compute the received power of a transmission at n receivers.
+   *
+   * If the first model of the chain is exactly a
+   * LogDistancePropagationLossModel (not a subclass, which may override its
+   * computation), its attenuation is computed for all receivers in a single
+   * pass over contiguous arrays, without virtual calls, and the rest of the
+   * chain is then applied to each receiver. Any other model is evaluated one
+   * receiver at a time. In both cases, the result is the same as calling
+   * CalcRxPower on each link.
+   *
+   * \param loss The first model of the propagation loss chain.
+   * \param txPowerDbm The power the transmitter is using, in dBm.
+   * \param sender The mobility model of the sender.
+   * \param receivers Pointer to the n mobility models of the receivers.
+   * \param n The number of receivers.
+   * \param rxPowerDbm Pointer to the n values to write, in dBm.
+   */
+  static void CalcRxPowerBatch (Ptr<PropagationLossModel> loss,
+                                double txPowerDbm,
+                                Ptr<MobilityModel> sender,
+                                const Ptr<MobilityModel> *receivers,
+                                std::size_t n, double *rxPowerDbm);
+
   /**
    * Modify the list of the transmission events
    */
   void InterruptTx (Ptr<LoraPhy> sender, Ptr<Packet> packet, Time realDuration);
 
+  /**
+   * Set whether transmissions are recorded once in a ledger shared by all
+   * connected PHYs, instead of having each PHY store its own copy of every
+   * signal it receives.
+   *
+   * \param enable Whether to use the shared ledger.
+   */
+  void SetSharedInterferenceLedger (bool enable);
+
+  /**
+   * Get whether transmissions are recorded in a shared ledger.
+   */
+  bool GetSharedInterferenceLedger (void) const;
+
+  /**
+   * Set the time after the end of a transmission after which it is removed
+   * from the shared ledger.
+   *
+   * \param threshold The new threshold.
+   */
+  void SetOldEventThreshold (Time threshold);
+
+  /**
+   * Get the time after the end of a transmission after which it is removed
+   * from the shared ledger.
+   */
+  Time GetOldEventThreshold (void) const;
+
+  /**
+   * Set whether transmissions are only delivered to the PHYs that listen on
+   * their frequency.
+   *
+   * \param enable Whether to use frequency subscriptions.
+   */
+  void SetFrequencySubscriptions (bool enable);
+
+  /**
+   * Get whether transmissions are only delivered to the PHYs that listen on
+   * their frequency.
+   */
+  bool GetFrequencySubscriptions (void) const;
+
+  /**
+   * Update the frequencies a PHY receives transmissions on, based on its
+   * GetListeningFrequencies method.
+   *
+   * This is called by PHYs when they change the frequencies they listen on.
+   *
+   * \param phy The PHY, which must be connected to this channel.
+   */
+  void UpdateFrequencySubscription (Ptr<LoraPhy> phy);
+
+  /**
+   * Let the channel know that the mobility model or the device of a PHY
+   * changed.
+   *
+   * This is called by PHYs when SetMobility or SetDevice are used.
+   */
+  void InvalidateReceiverTable (void);
+
+  /**
+   * Set whether the link budget (received power and delay) of each pair of
+   * PHYs is computed once and then reused.
+   *
+   * Only the output of propagation models declared as deterministic is
+   * cached. The values of the links involving a PHY are discarded whenever
+   * its mobility model fires its CourseChange trace. Since models like
+   * ConstantVelocityMobilityModel move without firing it, links are only
+   * cached between PHYs using a ConstantPositionMobilityModel.
+   *
+   * \param enable Whether to use the link budget cache.
+   */
+  void SetLinkBudgetCache (bool enable);
+
+  /**
+   * Get whether the link budget of each pair of PHYs is cached.
+   */
+  bool GetLinkBudgetCache (void) const;
+
+  /**
+   * Declare that a propagation loss or delay model gives the same output
+   * every time it is evaluated on the same link, so that its results can be
+   * cached.
+   *
+   * For loss models, the loss must also not depend on the transmission
+   * power.
+   *
+   * \param tid The TypeId of the model.
+   */
+  static void DeclareDeterministic (TypeId tid);
+
+  /**
+   * Check whether all loss models in a chain were declared deterministic.
+   * BuildingPenetrationLoss models are also accepted when they keep the loss
+   * of each link fixed.
+   *
+   * \param loss The first model of the chain.
+   * \return Whether the output of the chain can be cached.
+   */
+  static bool IsDeterministic (Ptr<PropagationLossModel> loss);
+
+  /**
+   * Check whether a delay model was declared deterministic.
+   *
+   * \param delay The delay model.
+   * \return Whether the output of the model can be cached.
+   */
+  static bool IsDeterministic (Ptr<PropagationDelayModel> delay);
+
+  /**
+   * Compute the distance beyond which no connected PHY can receive a
+   * transmission, or be meaningfully interfered by it.
+   *
+   * The range is derived from the path loss of the first model in the loss
+   * chain, which needs to be exactly a LogDistancePropagationLossModel whose
+   * parameters are read when it is set on the channel, and from the
+   * lowest sensitivity of the connected PHYs. The remaining models in the
+   * chain are assumed not to improve the link budget by more than the
+   * CullingMarginDb attribute.
+   *
+   * \param txPowerDbm The transmission power.
+   * \return The range in meters, or infinity if it cannot be derived.
+   */
+  double GetMaxRange (double txPowerDbm) const;
+
 private:
+  /**
+   * The cached propagation results for a pair of PHYs.
+   */
+  struct LinkBudget
+  {
+    bool hasRxPower;   //!< Whether txPowerDbm and rxPowerDbm are valid.
+    bool hasDelay;     //!< Whether delay is valid.
+    double txPowerDbm; //!< The transmission power rxPowerDbm refers to.
+    double rxPowerDbm; //!< The received power.
+    Time delay;        //!< The propagation delay.
+  };
+
+  /**
+   * The parameters of a LogDistancePropagationLossModel at the head of a
+   * loss chain, read once so that they can be used without attribute
+   * lookups.
+   */
+  struct PathLossParameters
+  {
+    bool valid = false;       //!< Whether the chain starts with the model
+    double exponent = 0;      //!< The path loss exponent
+    double referenceDistance = 0; //!< The reference distance, in meters
+    double referenceLoss = 0; //!< The loss at the reference distance, in dB
+  };
+
+  /**
+   * Read the parameters of the LogDistancePropagationLossModel at the head
+   * of a loss chain.
+   *
+   * \param loss The first model of the chain.
+   * \return The parameters, which are not valid if the first model is not
+   * exactly a LogDistancePropagationLossModel.
+   */
+  static PathLossParameters GetPathLossParameters (Ptr<PropagationLossModel> loss);
+
+  /**
+   * Compute the power a transmission is received with at many receivers,
+   * whose positions are already known.
+   *
+   * \param pathLoss The parameters of the head of the chain.
+   * \param loss The first model of the propagation loss chain.
+   * \param txPowerDbm The power the transmitter is using, in dBm.
+   * \param sender The mobility model of the sender.
+   * \param receivers Pointer to the n mobility models of the receivers.
+   * \param positions Pointer to the n positions of the receivers.
+   * \param n The number of receivers.
+   * \param rxPowerDbm Pointer to the n values to write, in dBm.
+   */
+  static void DoCalcRxPowerBatch (const PathLossParameters &pathLoss,
+                                  Ptr<PropagationLossModel> loss,
+                                  double txPowerDbm,
+                                  Ptr<MobilityModel> sender,
+                                  const Ptr<MobilityModel> *receivers,
+                                  const Vector *positions,
+                                  std::size_t n, double *rxPowerDbm);
+
+  /**
+   * Get the names of the models declared as deterministic.
+   */
+  static std::set<std::string> &GetDeterministicModels (void);
+
+  /**
+   * Update the receiver table rows, grid cells and cached link budgets of
+   * the PHYs of a node that moved.
+   *
+   * \param mobility The mobility model that changed.
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility) const;
+
+  /**
+   * Update the position of a PHY in the receiver table and in the grid, and
+   * discard the cached link budgets involving it.
+   *
+   * \param j The index of the PHY.
+   */
+  void UpdatePosition (uint32_t j) const;
+
+  /**
+   * Make sure the table and the cache are updated when a PHY moves.
+   *
+   * \param i The index of the PHY.
+   * \param mobility The mobility model of the PHY.
+   */
+  void WatchMobility (uint32_t i, Ptr<MobilityModel> mobility) const;
+
+  /**
+   * Place the connected PHYs that are not mobile in a uniform grid based on
+   * their position.
+   *
+   * \param cellSize The side of a grid cell, in meters.
+   */
+  void BuildGrid (double cellSize) const;
+
+  /**
+   * Get the key of the grid cell containing a point.
+   *
+   * \param x The x coordinate of the point.
+   * \param y The y coordinate of the point.
+   */
+  uint64_t GetCellKey (double x, double y) const;
+
+  /**
+   * Find the PHYs that are within a given distance from a point.
+   *
+   * Mobile PHYs are checked against their current position.
+   *
+   * \param position The point.
+   * \param range The distance in meters.
+   * \param candidates Filled with the indexes of the PHYs, in increasing
+   * order.
+   */
+  void GetPhysInRange (Vector position, double range,
+                       std::vector<uint32_t> &candidates) const;
+
+  /**
+   * Refresh the receiver table from the connected PHYs.
+   */
+  void RefreshReceiverTable (void) const;
+
+  /**
+   * Stop watching the mobility model of a PHY.
+   *
+   * \param i The index of the PHY.
+   */
+  void UnwatchMobility (uint32_t i) const;
+
   /**
     * Private method that is scheduled by LoraChannel's Send method to happen
     * after the channel delay, for each of the connected PHY layers.
@@ -173,6 +486,39 @@ private:
   void Receive (uint32_t i, Ptr<Packet> packet,
                 LoraChannelParameters parameters) const;
 
+  /**
+   * A reception that is part of a fan-out delivery.
+   */
+  struct Delivery
+  {
+    uint32_t i;        //!< The index of the receiving PHY.
+    uint32_t context;  //!< The id of the node of the receiving PHY.
+    double rxPowerDbm; //!< The reception power.
+    Time delay;        //!< The delay since the transmission started.
+  };
+
+  /**
+   * All the receptions of a transmission, delivered one after the other by a
+   * single chain of events.
+   */
+  struct FanOut : public SimpleRefCount<FanOut>
+  {
+    Ptr<Packet> packet;                //!< The packet being delivered.
+    LoraChannelParameters parameters;  //!< The parameters shared by all receptions.
+    std::vector<Delivery> deliveries;  //!< The receptions, sorted by delay.
+  };
+
+  /**
+   * Deliver a reception of a fan-out, and schedule the next one.
+   *
+   * The next reception is scheduled in the context of its node, so that at
+   * most one event per transmission is pending in the scheduler.
+   *
+   * \param fanOut The fan-out being delivered.
+   * \param k The index of the reception to deliver.
+   */
+  void DeliverFanOut (Ptr<FanOut> fanOut, uint32_t k) const;
+
   /**
     * The vector containing the PHYs that are currently connected to the
     * channel.
@@ -187,6 +533,11 @@ private:
     */
   Ptr<PropagationLossModel> m_loss;
 
+  /**
+   * The parameters of the head of m_loss, read when it is set.
+   */
+  PathLossParameters m_pathLoss;
+
   /**
     * Pointer to the delay model.
     */
@@ -197,6 +548,189 @@ private:
    */
   TracedCallback<Ptr<const Packet> > m_packetSent;
 
+  /**
+   * Whether transmissions are recorded in m_ledger.
+   */
+  bool m_sharedLedger;
+
+  /**
+   * The ledger holding each transmission once, together with the power it
+   * is received with at each PHY.
+   *
+   * This is modified by Send, which is const for the PHY layers.
+   */
+  mutable LoraInterferenceHelper m_ledger;
+
+  /**
+   * The id of each PHY in m_ledger, in the same order as m_phyList.
+   *
+   * Ids are never reused, so they also identify links in m_linkBudgets.
+   */
+  std::vector<uint32_t> m_ledgerIds;
+
+  /**
+   * Whether link budgets are cached.
+   */
+  bool m_linkBudgetCache;
+
+  /**
+   * The cached link budgets, indexed by the ids of the sender (upper 32
+   * bits) and of the receiver (lower 32 bits).
+   */
+  mutable std::unordered_map<uint64_t, LinkBudget> m_linkBudgets;
+
+  /**
+   * \name Receiver table
+   *
+   * Per-PHY data used by Send, stored in contiguous arrays in the same order
+   * as m_phyList so that transmissions can be delivered without going
+   * through the PHY, device and node objects. The table is refreshed on the
+   * first transmission after PHYs are added or removed, while the rows of
+   * PHYs that move are updated in place.
+   */
+  //\{
+
+  /**
+   * The index of each PHY in m_phyList.
+   */
+  std::unordered_map<const LoraPhy *, uint32_t> m_phyIndex;
+
+  /**
+   * The mobility model of each PHY, whose CourseChange trace we are
+   * connected to.
+   */
+  mutable std::vector<Ptr<MobilityModel> > m_phyMobility;
+
+  /**
+   * The index of the PHYs each watched mobility model belongs to.
+   */
+  mutable std::unordered_multimap<const MobilityModel *, uint32_t> m_mobilityIndex;
+
+  /**
+   * The position of each PHY.
+   *
+   * This is only up to date for the PHYs that are not mobile.
+   */
+  mutable std::vector<Vector> m_phyPositions;
+
+  /**
+   * Whether each PHY uses a mobility model other than
+   * ConstantPositionMobilityModel, and can thus move without firing its
+   * CourseChange trace.
+   */
+  mutable std::vector<uint8_t> m_phyMobile;
+
+  /**
+   * The id of the node of each PHY, used as the context of its receptions.
+   */
+  mutable std::vector<uint32_t> m_phyContexts;
+
+  /**
+   * Whether each PHY listens to inverted IQ signals, i.e., whether it's an
+   * end device.
+   */
+  mutable std::vector<uint8_t> m_phyInvertedIq;
+
+  /**
+   * Whether the receiver table reflects the current PHYs and positions.
+   */
+  mutable bool m_tableValid;
+
+  //\}
+
+  /**
+   * Subscribe a PHY to the frequencies it listens on.
+   *
+   * \param j The index of the PHY.
+   */
+  void Subscribe (uint32_t j);
+
+  /**
+   * Rebuild all the frequency subscriptions.
+   */
+  void RebuildSubscriptions (void);
+
+  /**
+   * Whether transmissions are only delivered to the PHYs subscribed to their
+   * frequency.
+   */
+  bool m_frequencySubscriptions;
+
+  /**
+   * The frequencies each PHY is subscribed to, in the same order as
+   * m_phyList.
+   */
+  std::vector<std::vector<double> > m_phyFrequencies;
+
+  /**
+   * The indexes of the PHYs subscribed to each frequency, in increasing
+   * order.
+   */
+  std::map<double, std::vector<uint32_t> > m_subscribers;
+
+  /**
+   * Whether transmissions are only delivered to PHYs listening with the same
+   * IQ polarity.
+   */
+  bool m_iqPolarityFiltering;
+
+  /**
+   * Whether receptions are delivered by one chain of events per
+   * transmission.
+   */
+  bool m_fanOutDelivery;
+
+  /**
+   * The resolution propagation delays are rounded down to when using fan-out
+   * delivery.
+   */
+  Time m_fanOutDelayResolution;
+
+  /**
+   * Whether Send only visits the PHYs within the maximum range.
+   */
+  bool m_receiverCulling;
+
+  /**
+   * The margin used when computing the maximum range, in dB.
+   */
+  double m_cullingMarginDb;
+
+  /**
+   * Whether m_grid reflects the current PHYs and positions.
+   */
+  mutable bool m_gridValid;
+
+  /**
+   * The side of a cell of m_grid, in meters.
+   */
+  mutable double m_gridCellSize;
+
+  /**
+   * The lowest sensitivity of the connected PHYs, updated with m_grid.
+   */
+  mutable double m_minSensitivity;
+
+  /**
+   * The indexes of the PHYs in each cell of a uniform grid on the xy plane.
+   */
+  mutable std::unordered_map<uint64_t, std::vector<uint32_t> > m_grid;
+
+  /**
+   * The indexes of the mobile PHYs, which are kept out of m_grid and
+   * checked against their current position instead.
+   */
+  mutable std::vector<uint32_t> m_mobilePhys;
+
+  /**
+   * Scratch buffers used by Send to compute the received powers of the PHYs
+   * that are missing from the link budget cache in a single batch.
+   */
+  mutable std::vector<uint32_t> m_batchPhys;
+  mutable std::vector<Ptr<MobilityModel> > m_batchMobility;
+  mutable std::vector<Vector> m_batchPositions;
+  mutable std::vector<double> m_batchRxPowerDbm;
+
 };
 
 } /* namespace ns3 */
@@ -210,7 +210,7 @@ public:
    * in this header.
    */
   template<typename T>
-  inline Ptr<T> GetMacCommand (void);
+  inline Ptr<T> GetMacCommand (void) const;
 
   /**
    * Add a LinkCheckReq command.
@@ -322,7 +322,7 @@ private:
 
 template<typename T>
 Ptr<T>
-LoraFrameHeader::GetMacCommand ()
+LoraFrameHeader::GetMacCommand () const
 {
   // Iterate on MAC commands and try casting
   std::list< Ptr< MacCommand> >::const_iterator it;
@@ -23,6 +23,8 @@
 #include "ns3/log.h"
 #include "ns3/enum.h"
 #include <bits/stdint-uintn.h>
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 namespace ns3 {
@@ -41,8 +43,24 @@ LoraInterferenceHelper::Event::Event (Time duration, double rxPowerdBm, uint8_t
       m_endTime (m_startTime + duration),
       m_sf (spreadingFactor),
       m_rxPowerdBm (rxPowerdBm),
+      m_rxPowerW (pow (10, rxPowerdBm / 10) / 1000),
       m_packet (packet),
-      m_frequencyMHz (frequencyMHz)
+      m_frequencyMHz (frequencyMHz),
+      m_bandwidthHz (125000)
+{
+  // NS_LOG_FUNCTION_NOARGS ();
+}
+
+LoraInterferenceHelper::Event::Event (Time duration, uint8_t spreadingFactor, Ptr<Packet> packet,
+                                      double frequencyMHz)
+    : m_startTime (Simulator::Now ()),
+      m_endTime (m_startTime + duration),
+      m_sf (spreadingFactor),
+      m_rxPowerdBm (-std::numeric_limits<double>::infinity ()),
+      m_rxPowerW (0),
+      m_packet (packet),
+      m_frequencyMHz (frequencyMHz),
+      m_bandwidthHz (125000)
 {
   // NS_LOG_FUNCTION_NOARGS ();
 }
@@ -78,6 +96,47 @@ LoraInterferenceHelper::Event::GetRxPowerdBm (void) const
   return m_rxPowerdBm;
 }
 
+double
+LoraInterferenceHelper::Event::GetRxPowerW (void) const
+{
+  return m_rxPowerW;
+}
+
+void
+LoraInterferenceHelper::Event::SetRxPowerdBm (uint32_t receiverId, double rxPowerdBm)
+{
+  double rxPowerW = pow (10, rxPowerdBm / 10) / 1000;
+
+  // Receivers are usually visited in id order, so this is mostly an append
+  auto it = std::lower_bound (m_receiverRxPowerW.begin (), m_receiverRxPowerW.end (), receiverId,
+                              [] (const std::pair<uint32_t, double> &p, uint32_t id) {
+                                return p.first < id;
+                              });
+  if (it != m_receiverRxPowerW.end () && it->first == receiverId)
+    {
+      it->second = rxPowerW;
+    }
+  else
+    {
+      m_receiverRxPowerW.insert (it, std::make_pair (receiverId, rxPowerW));
+    }
+}
+
+double
+LoraInterferenceHelper::Event::GetRxPowerW (uint32_t receiverId) const
+{
+  auto it = std::lower_bound (m_receiverRxPowerW.begin (), m_receiverRxPowerW.end (), receiverId,
+                              [] (const std::pair<uint32_t, double> &p, uint32_t id) {
+                                return p.first < id;
+                              });
+  // Receivers this transmission was not delivered to have no entry
+  if (it == m_receiverRxPowerW.end () || it->first != receiverId)
+    {
+      return 0;
+    }
+  return it->second;
+}
+
 uint8_t
 LoraInterferenceHelper::Event::GetSpreadingFactor (void) const
 {
@@ -96,6 +155,27 @@ LoraInterferenceHelper::Event::GetFrequency (void) const
   return m_frequencyMHz;
 }
 
+void
+LoraInterferenceHelper::Event::SetBandwidth (double bandwidthHz)
+{
+  m_bandwidthHz = bandwidthHz;
+}
+
+double
+LoraInterferenceHelper::Event::GetBandwidth (void) const
+{
+  return m_bandwidthHz;
+}
+
+void
+LoraInterferenceHelper::Event::Truncate (Time duration)
+{
+  if (m_startTime + duration < m_endTime)
+    {
+      m_endTime = m_startTime + duration;
+    }
+}
+
 void
 LoraInterferenceHelper::Event::Print (std::ostream &stream) const
 {
@@ -116,9 +196,9 @@ operator<< (std::ostream &os, const LoraInterferenceHelper::Event &event)
  ****************************/
 // This collision matrix can be used for comparisons with the performance of Aloha
 // systems, where collisions imply the loss of both packets.
-double inf = std::numeric_limits<double>::max ();
-double minf = std::numeric_limits<double>::min ();
-  std::vector<std::vector<double>> LoraInterferenceHelper::collisionSnirAloha= {
+constexpr double inf = std::numeric_limits<double>::max ();
+constexpr double minf = std::numeric_limits<double>::min ();
+const double LoraInterferenceHelper::collisionSnirAloha[6][6] = {
     //   7   8   9  10  11  12
     {inf, minf, minf, minf, minf, minf}, // SF7
     {minf, inf, minf, minf, minf, minf}, // SF8
@@ -132,7 +212,7 @@ double minf = std::numeric_limits<double>::min ();
 // Values are inverted w.r.t. the paper since here we interpret this as an
 // _isolation_ matrix instead of a cochannel _rejection_ matrix like in
 // Goursaud's paper.
-  std::vector<std::vector<double>> LoraInterferenceHelper::collisionSnirGoursaud= {
+const double LoraInterferenceHelper::collisionSnirGoursaud[6][6] = {
     // SF7  SF8  SF9  SF10 SF11 SF12
     {6, -16, -18, -19, -19, -20}, // SF7
     {-24, 6, -20, -22, -22, -22}, // SF8
@@ -142,6 +222,39 @@ double minf = std::numeric_limits<double>::min ();
     {-36, -36, -36, -36, -36, 6} // SF12
 };
 
+/*********************************************
+ *  LoraInterferenceHelper::CollisionTable   *
+ *********************************************/
+
+LoraInterferenceHelper::CollisionTable::CollisionTable (const double snirDb[6][6])
+{
+  // Convert the isolation values to linear units once, so that no
+  // logarithms need to be computed when checking for interference
+  for (unsigned int i = 0; i < 6; i++)
+    {
+      for (unsigned int j = 0; j < 6; j++)
+        {
+          m_snirDb[i][j] = snirDb[i][j];
+          m_snirLinear[i][j] = pow (10, snirDb[i][j] / 10);
+        }
+    }
+}
+
+double
+LoraInterferenceHelper::CollisionTable::GetIsolationDb (uint8_t sf, uint8_t interfererSf) const
+{
+  return m_snirDb[unsigned(sf) - 7][unsigned(interfererSf) - 7];
+}
+
+const double *
+LoraInterferenceHelper::CollisionTable::GetIsolationLinear (uint8_t sf) const
+{
+  return m_snirLinear[unsigned(sf) - 7];
+}
+
+Ptr<const LoraInterferenceHelper::CollisionTable>
+    LoraInterferenceHelper::customCollisionTable = 0;
+
 LoraInterferenceHelper::CollisionMatrix LoraInterferenceHelper::collisionMatrix =
     LoraInterferenceHelper::GOURSAUD;
 
@@ -151,19 +264,40 @@ void
 LoraInterferenceHelper::SetCollisionMatrix (
     enum LoraInterferenceHelper::CollisionMatrix collisionMatrix)
 {
+  // The built-in tables are created once, and then shared by all helpers
+  static Ptr<const LoraInterferenceHelper::CollisionTable> alohaTable =
+      Create<LoraInterferenceHelper::CollisionTable> (LoraInterferenceHelper::collisionSnirAloha);
+  static Ptr<const LoraInterferenceHelper::CollisionTable> goursaudTable =
+      Create<LoraInterferenceHelper::CollisionTable> (
+          LoraInterferenceHelper::collisionSnirGoursaud);
+
   switch (collisionMatrix)
     {
     case LoraInterferenceHelper::ALOHA:
       NS_LOG_DEBUG ("Setting the ALOHA collision matrix");
-      m_collisionSnir = LoraInterferenceHelper::collisionSnirAloha;
+      m_collisionSnir = alohaTable;
       break;
     case LoraInterferenceHelper::GOURSAUD:
       NS_LOG_DEBUG ("Setting the GOURSAUD collision matrix");
-      m_collisionSnir = LoraInterferenceHelper::collisionSnirGoursaud;
+      m_collisionSnir = goursaudTable;
+      break;
+    case LoraInterferenceHelper::CUSTOM:
+      NS_LOG_DEBUG ("Setting the CUSTOM collision matrix");
+      NS_ASSERT_MSG (customCollisionTable != 0,
+                     "SetCustomCollisionMatrix must be called before using CUSTOM");
+      m_collisionSnir = customCollisionTable;
       break;
     }
 }
 
+void
+LoraInterferenceHelper::SetCustomCollisionMatrix (const double snirDb[6][6])
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  customCollisionTable = Create<LoraInterferenceHelper::CollisionTable> (snirDb);
+}
+
 TypeId
 LoraInterferenceHelper::GetTypeId (void)
 {
@@ -173,7 +307,14 @@ LoraInterferenceHelper::GetTypeId (void)
   return tid;
 }
 
-  LoraInterferenceHelper::LoraInterferenceHelper () : m_collisionSnir(LoraInterferenceHelper::collisionSnirGoursaud)
+LoraInterferenceHelper::LoraInterferenceHelper ()
+    : m_nEvents (0),
+      m_longestEvent (Seconds (0)),
+      m_oldEventThreshold (oldEventThreshold),
+      m_pruningFloorDbm (-std::numeric_limits<double>::infinity ()),
+      m_ledger (0),
+      m_receiverId (NO_RECEIVER),
+      m_nReceivers (0)
 {
   NS_LOG_FUNCTION (this);
 
@@ -187,6 +328,8 @@ LoraInterferenceHelper::~LoraInterferenceHelper ()
 
 Time LoraInterferenceHelper::oldEventThreshold = Seconds (2);
 
+const uint32_t LoraInterferenceHelper::NO_RECEIVER;
+
 Ptr<LoraInterferenceHelper::Event>
 LoraInterferenceHelper::Add (Time duration, double rxPower, uint8_t spreadingFactor,
                              Ptr<Packet> packet, double frequencyMHz)
@@ -195,42 +338,239 @@ LoraInterferenceHelper::Add (Time duration, double rxPower, uint8_t spreadingFac
   NS_LOG_FUNCTION (this << duration.GetSeconds () << rxPower << unsigned(spreadingFactor) << packet
                         << frequencyMHz);
 
+  NS_ASSERT_MSG (spreadingFactor >= 7 && spreadingFactor <= 12,
+                 "Unsupported spreading factor " << unsigned(spreadingFactor));
+
   // Create an event based on the parameters
   Ptr<LoraInterferenceHelper::Event> event = Create<LoraInterferenceHelper::Event> (
       duration, rxPower, spreadingFactor, packet, frequencyMHz);
 
-  // Add the event to the list
-  m_events.push_back (event);
+  // The transmission is already stored in the shared ledger, so the event is
+  // only needed to describe this reception.
+  if (m_ledger != 0)
+    {
+      return event;
+    }
 
-  // Clean the event list
-  if (m_events.size () > 100)
+  // Signals this weak cannot change the outcome of any reception
+  if (rxPower < m_pruningFloorDbm)
     {
-      CleanOldEvents ();
+      NS_LOG_DEBUG ("Not storing signal below the pruning floor of " << m_pruningFloorDbm
+                                                                     << " dBm");
+      return event;
     }
 
+  // Clean the event list
+  CleanOldEvents ();
+
+  // Add the event to the index
+  Insert (event);
+
   return event;
 }
 
-void
-LoraInterferenceHelper::CleanOldEvents (void)
+Ptr<LoraInterferenceHelper::Event>
+LoraInterferenceHelper::AddTransmission (Time duration, uint8_t spreadingFactor,
+                                         Ptr<Packet> packet, double frequencyMHz)
+{
+  NS_LOG_FUNCTION (this << duration.GetSeconds () << unsigned(spreadingFactor) << packet
+                        << frequencyMHz);
+
+  NS_ASSERT_MSG (spreadingFactor >= 7 && spreadingFactor <= 12,
+                 "Unsupported spreading factor " << unsigned(spreadingFactor));
+
+  Ptr<LoraInterferenceHelper::Event> event = Create<LoraInterferenceHelper::Event> (
+      duration, spreadingFactor, packet, frequencyMHz);
+
+  CleanOldEvents ();
+  Insert (event);
+
+  return event;
+}
+
+uint32_t
+LoraInterferenceHelper::AddReceiver (void)
 {
   NS_LOG_FUNCTION (this);
 
-  // Cycle the events, and clean up if an event is old.
-  for (auto it = m_events.begin (); it != m_events.end ();)
+  return m_nReceivers++;
+}
+
+void
+LoraInterferenceHelper::SetLedger (const LoraInterferenceHelper *ledger, uint32_t receiverId)
+{
+  NS_LOG_FUNCTION (this << ledger << receiverId);
+
+  m_ledger = ledger;
+  m_receiverId = ledger != 0 ? receiverId : NO_RECEIVER;
+
+  // Events stored so far are now either in the ledger or irrelevant
+  ClearAllEvents ();
+}
+
+void
+LoraInterferenceHelper::Insert (Ptr<LoraInterferenceHelper::Event> event)
+{
+  FrequencyEvents &channel = m_events[event->GetFrequency ()];
+
+  // Events are usually created at the current simulation time, so they can
+  // simply be appended at the end of the list.
+  Time startTime = event->GetStartTime ();
+  if (channel.events.empty () || channel.events.back ()->GetStartTime () <= startTime)
+    {
+      channel.events.push_back (event);
+    }
+  else
+    {
+      auto it = std::upper_bound (channel.events.begin (), channel.events.end (), startTime,
+                                  [] (const Time &t, const Ptr<LoraInterferenceHelper::Event> &e) {
+                                    return t < e->GetStartTime ();
+                                  });
+      channel.events.insert (it, event);
+    }
+
+  channel.durations.insert (event->GetDuration ());
+  if (event->GetDuration () > channel.maxDuration)
+    {
+      channel.maxDuration = event->GetDuration ();
+    }
+  if (event->GetDuration () > m_longestEvent)
+    {
+      m_longestEvent = event->GetDuration ();
+    }
+
+  // Events without a packet cannot be looked up, so there's no need to index
+  // them.
+  if (event->GetPacket () != 0)
     {
-      if ((*it)->GetEndTime () + oldEventThreshold < Simulator::Now ())
+      m_packetIndex.insert (std::make_pair (event->GetPacket ()->GetUid (), event));
+    }
+
+  m_expiryQueue.push (std::make_pair (event->GetEndTime (), event));
+
+  m_nEvents++;
+}
+
+void
+LoraInterferenceHelper::Remove (Ptr<LoraInterferenceHelper::Event> event)
+{
+  auto channelIt = m_events.find (event->GetFrequency ());
+  NS_ASSERT (channelIt != m_events.end ());
+  std::deque<Ptr<LoraInterferenceHelper::Event>> &events = channelIt->second.events;
+
+  // Old events are close to the front, so erasing them is cheap
+  auto it = std::lower_bound (events.begin (), events.end (), event->GetStartTime (),
+                              [] (const Ptr<LoraInterferenceHelper::Event> &e, const Time &t) {
+                                return e->GetStartTime () < t;
+                              });
+  while (it != events.end () && *it != event)
+    {
+      it++;
+    }
+  NS_ASSERT_MSG (it != events.end (), "Removing an event that is not stored");
+  events.erase (it);
+
+  FrequencyEvents &channel = channelIt->second;
+  channel.durations.erase (channel.durations.find (event->GetDuration ()));
+  UpdateMaxDuration (channel);
+
+  RemoveFromPacketIndex (event);
+  m_nEvents--;
+}
+
+void
+LoraInterferenceHelper::UpdateMaxDuration (FrequencyEvents &channel)
+{
+  Time oldMaxDuration = channel.maxDuration;
+  channel.maxDuration = channel.durations.empty () ? Seconds (0) : *channel.durations.rbegin ();
+
+  // Only look at the other frequencies if the longest event may be gone
+  if (oldMaxDuration == m_longestEvent && channel.maxDuration < oldMaxDuration)
+    {
+      m_longestEvent = Seconds (0);
+      for (auto it = m_events.begin (); it != m_events.end (); ++it)
         {
-          it = m_events.erase (it);
+          m_longestEvent = std::max (m_longestEvent, it->second.maxDuration);
+        }
+    }
+}
+
+void
+LoraInterferenceHelper::RemoveFromPacketIndex (Ptr<LoraInterferenceHelper::Event> event)
+{
+  if (event->GetPacket () == 0)
+    {
+      return;
+    }
+
+  auto range = m_packetIndex.equal_range (event->GetPacket ()->GetUid ());
+  for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == event)
+        {
+          m_packetIndex.erase (it);
+          return;
         }
-      it++;
     }
 }
 
+void
+LoraInterferenceHelper::CleanOldEvents (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // An event that is still being received may have started up to the longest
+  // duration seen ago, so interferers must be kept at least that long after
+  // their end, even if the threshold is shorter.
+  Time keep = std::max (m_oldEventThreshold, m_longestEvent);
+  Time now = Simulator::Now ();
+
+  // Each event is visited once, when it becomes old
+  while (!m_expiryQueue.empty () && m_expiryQueue.top ().first + keep < now)
+    {
+      Remove (m_expiryQueue.top ().second);
+      m_expiryQueue.pop ();
+    }
+}
+
+void
+LoraInterferenceHelper::SetOldEventThreshold (Time threshold)
+{
+  NS_LOG_FUNCTION (this << threshold);
+
+  m_oldEventThreshold = threshold;
+}
+
+Time
+LoraInterferenceHelper::GetOldEventThreshold (void) const
+{
+  return m_oldEventThreshold;
+}
+
+void
+LoraInterferenceHelper::SetPruningFloor (double floorDbm)
+{
+  NS_LOG_FUNCTION (this << floorDbm);
+
+  m_pruningFloorDbm = floorDbm;
+}
+
+double
+LoraInterferenceHelper::GetPruningFloor (void) const
+{
+  return m_pruningFloorDbm;
+}
+
 std::list<Ptr<LoraInterferenceHelper::Event>>
 LoraInterferenceHelper::GetInterferers ()
 {
-  return m_events;
+  std::list<Ptr<LoraInterferenceHelper::Event>> interferers;
+  for (auto &channel : m_events)
+    {
+      interferers.insert (interferers.end (), channel.second.events.begin (),
+                          channel.second.events.end ());
+    }
+  return interferers;
 }
 
 void
@@ -240,10 +580,13 @@ LoraInterferenceHelper::PrintEvents (std::ostream &stream)
 
   stream << "Currently registered events:" << std::endl;
 
-  for (auto it = m_events.begin (); it != m_events.end (); it++)
+  for (auto &channel : m_events)
     {
-      (*it)->Print (stream);
-      stream << std::endl;
+      for (auto &event : channel.second.events)
+        {
+          event->Print (stream);
+          stream << std::endl;
+        }
     }
 }
 
@@ -252,99 +595,58 @@ LoraInterferenceHelper::IsDestroyedByInterference (Ptr<LoraInterferenceHelper::E
 {
   NS_LOG_FUNCTION (this << event);
 
-  NS_LOG_INFO ("Current number of events in LoraInterferenceHelper: " << m_events.size ());
+  CleanOldEvents ();
+
+  NS_LOG_INFO ("Current number of events in LoraInterferenceHelper: " << m_nEvents);
 
   // We want to see the interference affecting this event: cycle through events
   // that overlap with this one and see whether it survives the interference or
   // not.
 
   // Gather information about the event
-  double rxPowerDbm = event->GetRxPowerdBm ();
   uint8_t sf = event->GetSpreadingFactor ();
-  double frequency = event->GetFrequency ();
-
-  // Handy information about the time frame when the packet was received
-  Time now = Simulator::Now ();
   Time duration = event->GetDuration ();
-  Time packetStartTime = now - duration;
-  Time packetEndTime = now;
-
-  // Get the list of interfering events
-  std::list<Ptr<LoraInterferenceHelper::Event>>::iterator it;
 
   // Energy for interferers of various SFs
-  std::vector<double> cumulativeInterferenceEnergy (6, 0);
+  double cumulativeInterferenceEnergy[6] = {0, 0, 0, 0, 0, 0};
 
-  // Cycle over the events
-  for (it = m_events.begin (); it != m_events.end ();)
+  if (m_ledger != 0)
     {
-      // Pointer to the current interferer
-      Ptr<LoraInterferenceHelper::Event> interferer = *it;
-
-      // Only consider the current event if the channel is the same: we
-      // assume there's no interchannel interference. Also skip the current
-      // event if it's the same that we want to analyze.
-      if (!(interferer->GetFrequency () == frequency) || interferer == event)
-        {
-          NS_LOG_DEBUG ("Different channel or same event");
-          it++;
-          continue; // Continues from the first line inside the for cycle
-        }
-
-      NS_LOG_DEBUG ("Interferer on same channel");
-
-      // Gather information about this interferer
-      uint8_t interfererSf = interferer->GetSpreadingFactor ();
-      double interfererPower = interferer->GetRxPowerdBm ();
-      Time interfererStartTime = interferer->GetStartTime ();
-      Time interfererEndTime = interferer->GetEndTime ();
-
-      NS_LOG_INFO ("Found an interferer: sf = " << unsigned(interfererSf)
-                                                << ", power = " << interfererPower
-                                                << ", start time = " << interfererStartTime
-                                                << ", end time = " << interfererEndTime);
+      m_ledger->AccumulateInterference (event, m_receiverId, cumulativeInterferenceEnergy);
+    }
+  else
+    {
+      AccumulateInterference (event, NO_RECEIVER, cumulativeInterferenceEnergy);
+    }
 
-      // Compute the fraction of time the two events are overlapping
-      Time overlap = GetOverlapTime (event, interferer);
+  // Use the computed cumulativeInterferenceEnergy to determine whether the
+  // interference with each SF destroys the packet
+  double signalEnergy = duration.GetSeconds () * event->GetRxPowerW ();
+  NS_LOG_DEBUG ("Signal energy: " << signalEnergy);
 
-      NS_LOG_DEBUG ("The two events overlap for " << overlap.GetSeconds () << " s.");
-
-      // Compute the equivalent energy of the interference
-      // Power [mW] = 10^(Power[dBm]/10)
-      // Power [W] = Power [mW] / 1000
-      double interfererPowerW = pow (10, interfererPower / 10) / 1000;
-      // Energy [J] = Time [s] * Power [W]
-      double interferenceEnergy = overlap.GetSeconds () * interfererPowerW;
-      cumulativeInterferenceEnergy.at (unsigned(interfererSf) - 7) += interferenceEnergy;
-      NS_LOG_DEBUG ("Interferer power in W: " << interfererPowerW);
-      NS_LOG_DEBUG ("Interference energy: " << interferenceEnergy);
-      it++;
-    }
+  // The isolation values needed by a packet with our SF to survive
+  // interferers of each SF, in linear units
+  const double *snirIsolation = m_collisionSnir->GetIsolationLinear (sf);
 
   // For each SF, check if there was destructive interference
   for (uint8_t currentSf = uint8_t (7); currentSf <= uint8_t (12); currentSf++)
     {
-      NS_LOG_DEBUG ("Cumulative Interference Energy: "
-                    << cumulativeInterferenceEnergy.at (unsigned(currentSf) - 7));
+      unsigned int i = unsigned(currentSf) - 7;
 
-      // Use the computed cumulativeInterferenceEnergy to determine whether the
-      // interference with this SF destroys the packet
-      double signalPowerW = pow (10, rxPowerDbm / 10) / 1000;
-      double signalEnergy = duration.GetSeconds () * signalPowerW;
-      NS_LOG_DEBUG ("Signal power in W: " << signalPowerW);
-      NS_LOG_DEBUG ("Signal energy: " << signalEnergy);
+      NS_LOG_DEBUG ("Cumulative Interference Energy: " << cumulativeInterferenceEnergy[i]);
 
       // Check whether the packet survives the interference of this SF
-      double snirIsolation = m_collisionSnir[unsigned(sf) - 7][unsigned(currentSf) - 7];
-      NS_LOG_DEBUG ("The needed isolation to survive is " << snirIsolation << " dB");
-      double snir =
-          10 * log10 (signalEnergy / cumulativeInterferenceEnergy.at (unsigned(currentSf) - 7));
-      NS_LOG_DEBUG ("The current SNIR is " << snir << " dB");
-
-      if (snir >= snirIsolation)
+      // Comparing the energy ratio with the linear isolation is equivalent to
+      // comparing the SNIR with the isolation in dB.
+      double snir = signalEnergy / cumulativeInterferenceEnergy[i];
+      NS_LOG_DEBUG ("The needed isolation to survive is "
+                    << m_collisionSnir->GetIsolationDb (sf, currentSf) << " dB");
+      NS_LOG_DEBUG ("The current SNIR is " << 10 * log10 (snir) << " dB");
+
+      if (snir >= snirIsolation[i])
         {
           // Move on and check the rest of the interferers
-          NS_LOG_DEBUG ("Packet survived interference with SF " << currentSf);
+          NS_LOG_DEBUG ("Packet survived interference with SF " << unsigned(currentSf));
         }
       else
         {
@@ -360,45 +662,130 @@ LoraInterferenceHelper::IsDestroyedByInterference (Ptr<LoraInterferenceHelper::E
   return uint8_t (0);
 }
 
+void
+LoraInterferenceHelper::AccumulateInterference (Ptr<LoraInterferenceHelper::Event> event,
+                                                uint32_t receiverId,
+                                                double cumulativeInterferenceEnergy[6]) const
+{
+  NS_LOG_FUNCTION (this << event << receiverId);
+
+  // Only consider events on the same channel: we assume there's no
+  // interchannel interference.
+  auto channelIt = m_events.find (event->GetFrequency ());
+  if (channelIt == m_events.end ())
+    {
+      return;
+    }
+
+  const std::deque<Ptr<LoraInterferenceHelper::Event>> &events = channelIt->second.events;
+
+  // Events starting before this point in time end before our event begins,
+  // while events starting after the end of our event cannot overlap with it.
+  Time windowStart = event->GetStartTime () - channelIt->second.maxDuration;
+  Time windowEnd = event->GetEndTime ();
+  auto it = std::lower_bound (events.begin (), events.end (), windowStart,
+                              [] (const Ptr<LoraInterferenceHelper::Event> &e, const Time &t) {
+                                return e->GetStartTime () < t;
+                              });
+
+  // Cycle over the events
+  for (; it != events.end () && (*it)->GetStartTime () < windowEnd; it++)
+    {
+      // Pointer to the current interferer
+      const Ptr<LoraInterferenceHelper::Event> &interferer = *it;
+
+      // Skip the current event if it's the same that we want to analyze. In a
+      // ledger, the transmission of our packet is a different event.
+      if (interferer == event ||
+          (receiverId != NO_RECEIVER && interferer->GetPacket () == event->GetPacket ()))
+        {
+          NS_LOG_DEBUG ("Same event");
+          continue; // Continues from the first line inside the for cycle
+        }
+
+      double interfererPowerW = receiverId == NO_RECEIVER ? interferer->GetRxPowerW ()
+                                                          : interferer->GetRxPowerW (receiverId);
+
+      // Transmissions in the ledger that never reached this receiver
+      if (interfererPowerW == 0)
+        {
+          continue;
+        }
+
+      NS_LOG_INFO ("Found an interferer: sf = "
+                   << unsigned(interferer->GetSpreadingFactor ())
+                   << ", power = " << 10 * log10 (interfererPowerW * 1000)
+                   << ", start time = " << interferer->GetStartTime ()
+                   << ", end time = " << interferer->GetEndTime ());
+
+      // Compute the fraction of time the two events are overlapping
+      Time overlap = GetOverlapTime (event, interferer);
+
+      NS_LOG_DEBUG ("The two events overlap for " << overlap.GetSeconds () << " s.");
+
+      // Compute the equivalent energy of the interference
+      // Energy [J] = Time [s] * Power [W]
+      double interferenceEnergy = overlap.GetSeconds () * interfererPowerW;
+      cumulativeInterferenceEnergy[unsigned(interferer->GetSpreadingFactor ()) - 7] +=
+          interferenceEnergy;
+      NS_LOG_DEBUG ("Interference energy: " << interferenceEnergy);
+    }
+}
+
 Ptr<LoraInterferenceHelper::Event>
 LoraInterferenceHelper::GetEvent (Ptr<Packet> packet)
 {
   NS_LOG_FUNCTION (this << packet);
 
-  std::list<Ptr<LoraInterferenceHelper::Event>>::iterator it;
-  for (it = m_events.begin (); it != m_events.end (); ++it)
+  Ptr<LoraInterferenceHelper::Event> event = 0;
+  if (packet != 0)
     {
-      Ptr<LoraInterferenceHelper::Event> interferer = *it;
-      if (interferer->GetPacket () == packet)
+      // Copies of this packet share the same uid, so we also need to compare
+      // the actual packet.
+      auto range = m_packetIndex.equal_range (packet->GetUid ());
+      for (auto it = range.first; it != range.second; ++it)
         {
-          return interferer;
+          if (it->second->GetPacket () == packet &&
+              (event == 0 || event->GetStartTime () <= it->second->GetStartTime ()))
+            {
+              event = it->second;
+            }
         }
     }
-  NS_LOG_ERROR ("Packet to interrupt not found!");
-  return 0;
+
+  if (event == 0)
+    {
+      NS_LOG_ERROR ("Packet to interrupt not found!");
+    }
+  return event;
 }
 
 void
-LoraInterferenceHelper::ModifyEvent (Ptr<Packet> packet, Time realDuration)    
+LoraInterferenceHelper::ModifyEvent (Ptr<Packet> packet, Time realDuration)
 {
   NS_LOG_FUNCTION (this << packet << realDuration);
 
-  Ptr<LoraInterferenceHelper::Event> interferer = GetEvent (packet);
-  double rxPower = interferer->GetRxPowerdBm ();
-  uint8_t sf = interferer->GetSpreadingFactor ();
-  double frequencyMHz = interferer->GetFrequency ();
-  // Remove previously inserted value
-  m_events.remove (interferer);
-
-  // Add new element with correct duration
-  // Create an event based on the parameters
-  Ptr<LoraInterferenceHelper::Event> event =
-      Create<LoraInterferenceHelper::Event> (realDuration, rxPower, sf, packet, frequencyMHz);
+  // With a shared ledger, the transmission is interrupted once by the
+  // channel, and no event is stored here.
+  if (m_ledger != 0)
+    {
+      return;
+    }
 
-  // Add the event to the list
-  m_events.push_back (event);
- }
+  Ptr<LoraInterferenceHelper::Event> event = GetEvent (packet);
+  if (event == 0)
+    {
+      return;
+    }
 
+  // Shortening the event keeps the ordering by start time, so only its
+  // duration needs to be updated in the index.
+  FrequencyEvents &channel = m_events[event->GetFrequency ()];
+  channel.durations.erase (channel.durations.find (event->GetDuration ()));
+  event->Truncate (realDuration);
+  channel.durations.insert (event->GetDuration ());
+  UpdateMaxDuration (channel);
+}
 
 void
 LoraInterferenceHelper::ClearAllEvents (void)
@@ -406,11 +793,15 @@ LoraInterferenceHelper::ClearAllEvents (void)
   NS_LOG_FUNCTION_NOARGS ();
 
   m_events.clear ();
+  m_packetIndex.clear ();
+  m_expiryQueue = std::priority_queue<Expiry, std::vector<Expiry>, LaterExpiry> ();
+  m_nEvents = 0;
+  m_longestEvent = Seconds (0);
 }
 
 Time
 LoraInterferenceHelper::GetOverlapTime (Ptr<LoraInterferenceHelper::Event> event1,
-                                        Ptr<LoraInterferenceHelper::Event> event2)
+                                        Ptr<LoraInterferenceHelper::Event> event2) const
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -29,6 +29,12 @@
 #include "ns3/packet.h"
 #include "ns3/logical-lora-channel.h"
 #include <list>
+#include <map>
+#include <deque>
+#include <unordered_map>
+#include <queue>
+#include <set>
+#include <vector>
 
 namespace ns3 {
 namespace lorawan {
@@ -55,6 +61,15 @@ public:
   public:
     Event (Time duration, double rxPowerdBm, uint8_t spreadingFactor, Ptr<Packet> packet,
            double frequencyMHz);
+
+    /**
+     * Create an event describing a transmission that is stored in a ledger
+     * shared by several receivers.
+     *
+     * Such an event does not have a power of its own: the power it is received
+     * with at each receiver is set via SetRxPowerdBm.
+     */
+    Event (Time duration, uint8_t spreadingFactor, Ptr<Packet> packet, double frequencyMHz);
     ~Event ();
 
     /**
@@ -77,6 +92,30 @@ public:
      */
     double GetRxPowerdBm (void) const;
 
+    /**
+     * Get the power of the event in W.
+     */
+    double GetRxPowerW (void) const;
+
+    /**
+     * Set the power this event is received with at a receiver attached to
+     * the ledger this event is stored in.
+     *
+     * \param receiverId The id of the receiver in the ledger.
+     * \param rxPowerdBm The received power in dBm.
+     */
+    void SetRxPowerdBm (uint32_t receiverId, double rxPowerdBm);
+
+    /**
+     * Get the power in W this event is received with at a receiver attached
+     * to the ledger this event is stored in.
+     *
+     * \param receiverId The id of the receiver in the ledger.
+     * \return The received power, or 0 if the event was not delivered to the
+     * receiver.
+     */
+    double GetRxPowerW (uint32_t receiverId) const;
+
     /**
      * Get the spreading factor used by this signal.
      */
@@ -92,6 +131,26 @@ public:
      */
     double GetFrequency (void) const;
 
+    /**
+     * Set the bandwidth of the signal, in Hz.
+     */
+    void SetBandwidth (double bandwidthHz);
+
+    /**
+     * Get the bandwidth of the signal, in Hz.
+     */
+    double GetBandwidth (void) const;
+
+    /**
+     * Cut this event short, so that it ends after the given duration.
+     *
+     * This is used when the transmission this event refers to is interrupted.
+     * The start time of the event is not modified.
+     *
+     * \param duration The actual duration of the event.
+     */
+    void Truncate (Time duration);
+
     /**
      * Print the current event in a human readable form.
      */
@@ -118,6 +177,14 @@ public:
      */
     double m_rxPowerdBm;
 
+    /**
+     * The power of this event in W (at the device).
+     *
+     * This is computed once at construction, since it's needed every time
+     * the event is considered as an interferer.
+     */
+    double m_rxPowerW;
+
     /**
      * The packet this event was generated for.
      */
@@ -127,11 +194,62 @@ public:
      * The frequency this event was on.
      */
     double m_frequencyMHz;
+
+    /**
+     * The bandwidth of the signal, in Hz.
+     */
+    double m_bandwidthHz;
+
+    /**
+     * The power of this event in W at the receivers it was delivered to, as
+     * (receiver id, power) pairs sorted by receiver id.
+     *
+     * This is only filled for events stored in a shared ledger, and only
+     * holds the receivers the transmission actually reached.
+     */
+    std::vector<std::pair<uint32_t, double>> m_receiverRxPowerW;
   };
 
   enum CollisionMatrix {
     GOURSAUD,
     ALOHA,
+    CUSTOM,
+  };
+
+  /**
+   * An immutable table of the isolation values needed by a packet to survive
+   * interference, in dB and in linear units.
+   *
+   * Tables are shared by all the LoraInterferenceHelper instances that use the
+   * same collision matrix, so that creating a helper does not require copying
+   * the matrix.
+   */
+  class CollisionTable : public SimpleRefCount<LoraInterferenceHelper::CollisionTable>
+  {
+  public:
+    /**
+     * Build a table from a matrix of isolation values.
+     *
+     * \param snirDb The isolation values in dB. Rows refer to the SF of the
+     * packet being received, columns to the SF of the interferer.
+     */
+    CollisionTable (const double snirDb[6][6]);
+
+    /**
+     * Get the isolation in dB a packet with a certain SF needs to survive
+     * interference by packets of another SF.
+     */
+    double GetIsolationDb (uint8_t sf, uint8_t interfererSf) const;
+
+    /**
+     * Get the isolation values in linear units a packet with a certain SF needs
+     * to survive interference by packets of each SF, starting from SF7.
+     */
+    const double *GetIsolationLinear (uint8_t sf) const;
+
+  private:
+    double m_snirDb[6][6]; //!< The isolation values in dB
+    double m_snirLinear[6][6]; //!< The isolation values in linear units
   };
 
   static TypeId GetTypeId (void);
@@ -153,6 +271,48 @@ public:
   Ptr<LoraInterferenceHelper::Event> Add (Time duration, double rxPower, uint8_t spreadingFactor,
                                           Ptr<Packet> packet, double frequencyMHz);
 
+  /**
+   * Record a transmission in this helper, which acts as a ledger shared by
+   * several receivers.
+   *
+   * The returned event is stored once for all receivers, which only need to
+   * set the power they receive it with.
+   *
+   * \param duration the duration of the packet.
+   * \param spreadingFactor the spreading factor used by the transmission.
+   * \param packet The packet carried by this transmission.
+   * \param frequencyMHz The frequency this transmission is sent at.
+   *
+   * \return the newly created event
+   */
+  Ptr<LoraInterferenceHelper::Event> AddTransmission (Time duration, uint8_t spreadingFactor,
+                                                      Ptr<Packet> packet, double frequencyMHz);
+
+  /**
+   * Register a new receiver in this ledger.
+   *
+   * Only transmissions recorded after this call can carry a power for the
+   * new receiver.
+   *
+   * \return The id of the receiver.
+   */
+  uint32_t AddReceiver (void);
+
+  /**
+   * Look for interferers in a shared ledger instead of keeping a private copy
+   * of each signal.
+   *
+   * When a ledger is set, Add only creates the event describing the
+   * reception, and IsDestroyedByInterference considers the transmissions
+   * stored in the ledger, with the power they have at this receiver. Overlaps
+   * are then computed with the times at which transmissions started at their
+   * sender, i.e., differences in propagation delay are neglected.
+   *
+   * \param ledger The ledger, or 0 to go back to keeping events locally.
+   * \param receiverId The id this receiver was given by the ledger.
+   */
+  void SetLedger (const LoraInterferenceHelper *ledger, uint32_t receiverId);
+
   /**
    * Get a list of the interferers currently registered at this
    * InterferenceHelper.
@@ -184,15 +344,27 @@ public:
    * \return The overlap time
    */
   Time GetOverlapTime (Ptr<LoraInterferenceHelper::Event> event1,
-                       Ptr<LoraInterferenceHelper::Event> event2);
+                       Ptr<LoraInterferenceHelper::Event> event2) const;
 
   /**
-   * Modify the duration of an event
+   * Modify the duration of the event associated to a packet.
+   *
+   * The event is truncated in place, so that references to it held by the
+   * PHY layer remain valid.
+   *
+   * \param packet The packet whose event needs to be modified.
+   * \param realDuration The actual duration of the transmission.
    */
   void ModifyEvent (Ptr<Packet> packet, Time realDuration);
 
   /**
-   * Return the event associated to a packet
+   * Return the event associated to a packet.
+   *
+   * If the same packet was received more than once, the most recent event is
+   * returned.
+   *
+   * \param packet The packet to look for.
+   * \return The event, or 0 if no event is associated to the packet.
    */
   Ptr<LoraInterferenceHelper::Event> GetEvent (Ptr<Packet> packet);
 
@@ -203,30 +375,223 @@ public:
 
   /**
    * Delete old events in this LoraInterferenceHelper.
+   *
+   * Events are considered old when more than the old event threshold, or the
+   * duration of the longest event seen if that is larger, has passed since
+   * their end. This is also done automatically when events are
+   * added or checked for interference.
    */
   void CleanOldEvents (void);
 
+  /**
+   * Set the power below which signals are not stored as interferers.
+   *
+   * Add still returns an event for such signals, so that the caller can
+   * describe their reception, but they are not considered when checking
+   * other events for interference. The default is -infinity, which keeps
+   * every signal.
+   *
+   * \param floorDbm The power threshold in dBm.
+   */
+  void SetPruningFloor (double floorDbm);
+
+  /**
+   * Get the power below which signals are not stored as interferers.
+   */
+  double GetPruningFloor (void) const;
+
+  /**
+   * Set the time after the end of an event after which the event is deleted.
+   *
+   * This only affects events added after this call.
+   *
+   * \param threshold The new threshold.
+   */
+  void SetOldEventThreshold (Time threshold);
+
+  /**
+   * Get the time after the end of an event after which the event is deleted.
+   */
+  Time GetOldEventThreshold (void) const;
+
+  /**
+   * Set the custom collision matrix, which is used by the helpers that are
+   * created while collisionMatrix is set to CUSTOM.
+   *
+   * Helpers that are already using a previously set custom matrix are not
+   * affected.
+   *
+   * \param snirDb The isolation values in dB. Rows refer to the SF of the
+   * packet being received, columns to the SF of the interferer.
+   */
+  static void SetCustomCollisionMatrix (const double snirDb[6][6]);
+
   static CollisionMatrix collisionMatrix;
 
-  static std::vector<std::vector<double>> collisionSnirAloha;
-  static std::vector<std::vector<double>> collisionSnirGoursaud;
+  /**
+   * Isolation matrices, in dB.
+   *
+   * These are compile-time constants: helpers share tables built from them
+   * instead of copying them.
+   */
+  static const double collisionSnirAloha[6][6];
+  static const double collisionSnirGoursaud[6][6];
 
 private:
+  /**
+   * The events impinging on a single frequency.
+   *
+   * Events are kept sorted by start time. Since no event is longer than
+   * maxDuration, the events that can overlap with a time interval [s, e) are
+   * the ones starting in [s - maxDuration, e), which can be found with a
+   * binary search. The durations of the stored events are kept in a
+   * multiset, so that the bound shrinks again once the longest event is
+   * removed.
+   */
+  struct FrequencyEvents
+  {
+    std::deque<Ptr<LoraInterferenceHelper::Event>> events; //!< Sorted by start time
+    std::multiset<Time> durations; //!< The durations of the stored events
+    Time maxDuration; //!< The longest of the stored durations
+  };
+
+  /**
+   * Recompute the longest duration of the events stored on a frequency, and
+   * of all stored events, after one of them was removed or shortened.
+   *
+   * \param channel The events on the frequency that changed.
+   */
+  void UpdateMaxDuration (FrequencyEvents &channel);
+
+  /**
+   * Insert an event in the index, keeping it sorted by start time.
+   *
+   * \param event The event to insert.
+   */
+  void Insert (Ptr<LoraInterferenceHelper::Event> event);
+
+  /**
+   * Remove an event from the packet index.
+   *
+   * \param event The event to remove.
+   */
+  void RemoveFromPacketIndex (Ptr<LoraInterferenceHelper::Event> event);
+
+  /**
+   * Remove an event from the index.
+   *
+   * \param event The event to remove.
+   */
+  void Remove (Ptr<LoraInterferenceHelper::Event> event);
+
+  /**
+   * The end time of an event, paired with the event.
+   */
+  typedef std::pair<Time, Ptr<LoraInterferenceHelper::Event>> Expiry;
+
+  /**
+   * Ordering that puts the earliest end at the top of a priority queue.
+   */
+  struct LaterExpiry
+  {
+    bool
+    operator() (const Expiry &a, const Expiry &b) const
+    {
+      return a.first > b.first;
+    }
+  };
+
+  /**
+   * Add the energy of the events stored in this helper that overlap with the
+   * given event to the per-SF interference energy.
+   *
+   * \param event The event being received.
+   * \param receiverId The id of the receiver in this ledger, or NO_RECEIVER
+   * if the events stored here carry their own power.
+   * \param cumulativeInterferenceEnergy The energy of interferers of each SF.
+   */
+  void AccumulateInterference (Ptr<LoraInterferenceHelper::Event> event, uint32_t receiverId,
+                               double cumulativeInterferenceEnergy[6]) const;
+
+  /**
+   * Receiver id used for events that carry their own power.
+   */
+  static const uint32_t NO_RECEIVER = 0xffffffff;
+
   void SetCollisionMatrix (enum CollisionMatrix collisionMatrix);
 
-  std::vector<std::vector<double>> m_collisionSnir;
+  /**
+   * The table containing information about how packets survive interference.
+   */
+  Ptr<const LoraInterferenceHelper::CollisionTable> m_collisionSnir;
 
   /**
-   * A list of the events this LoraInterferenceHelper is keeping track of.
+   * The table built by the last call to SetCustomCollisionMatrix.
    */
-  std::list<Ptr<LoraInterferenceHelper::Event>> m_events;
+  static Ptr<const LoraInterferenceHelper::CollisionTable> customCollisionTable;
 
   /**
-   * The matrix containing information about how packets survive interference.
+   * The events this LoraInterferenceHelper is keeping track of, indexed by
+   * frequency.
    */
+  std::map<double, FrequencyEvents> m_events;
+
+  /**
+   * The events this LoraInterferenceHelper is keeping track of, indexed by the
+   * uid of their packet.
+   *
+   * This is a multimap since copies of a packet share the same uid.
+   */
+  std::unordered_multimap<uint64_t, Ptr<LoraInterferenceHelper::Event>> m_packetIndex;
+
+  /**
+   * The total number of events this LoraInterferenceHelper is keeping track of.
+   */
+  std::size_t m_nEvents;
+
+  /**
+   * The events this LoraInterferenceHelper is keeping track of, ordered by
+   * their end time.
+   *
+   * Events that are truncated keep their original end time, which only
+   * makes them last a little longer.
+   */
+  std::priority_queue<Expiry, std::vector<Expiry>, LaterExpiry> m_expiryQueue;
+
+  /**
+   * The duration of the longest stored event.
+   */
+  Time m_longestEvent;
+
+  /**
+   * The time after the end of an event after which the event is deleted.
+   */
+  Time m_oldEventThreshold;
+
+  /**
+   * The power in dBm below which signals are not stored.
+   */
+  double m_pruningFloorDbm;
+
+  /**
+   * The ledger interferers are looked up in, or 0 if events are kept by this
+   * helper.
+   */
+  const LoraInterferenceHelper *m_ledger;
+
+  /**
+   * The id of this receiver in m_ledger.
+   */
+  uint32_t m_receiverId;
+
+  /**
+   * The number of receivers attached to this helper, when used as a ledger.
+   */
+  uint32_t m_nReceivers;
+
   /**
-   * The threshold after which an event is considered old and removed from the
-   * list.
+   * The default threshold after which an event is considered old and removed
+   * from the list.
    */
   static Time oldEventThreshold;
 };
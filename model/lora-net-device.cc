@@ -19,6 +19,7 @@
  */
 
 #include "ns3/lora-net-device.h"
+#include "ns3/lora-tag.h"
 #include "ns3/pointer.h"
 #include "ns3/node.h"
 #include "ns3/log.h"
@@ -119,15 +120,37 @@ LoraNetDevice::Send (Ptr<Packet> packet)
 }
 
 void
-LoraNetDevice::Receive (Ptr<Packet> packet)
+LoraNetDevice::Receive (Ptr<Packet> packet, const LoraRxParameters &rxParams)
 {
-  NS_LOG_FUNCTION (this << packet);
+  NS_LOG_FUNCTION (this << packet << rxParams);
+
+  if (!m_loraReceiveCallback.IsNull ())
+    {
+      NS_LOG_DEBUG ("Calling loraReceiveCallback");
+      m_loraReceiveCallback (this, packet, rxParams);
+      return;
+    }
+
+  // The generic callback only gets the packet, so the parameters of the
+  // reception have to travel in its LoraTag
+  LoraTag tag;
+  packet->RemovePacketTag (tag);
+  tag.SetReceivePower (rxParams.rxPowerDbm);
+  tag.SetFrequency (rxParams.frequencyMHz);
+  packet->AddPacketTag (tag);
 
   // Fill protocol and address with empty stuff
   NS_LOG_DEBUG ("Calling receiveCallback");
   m_receiveCallback (this, packet, 0, Address ());
 }
 
+void
+LoraNetDevice::SetLoraReceiveCallback (LoraReceiveCallback cb)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  m_loraReceiveCallback = cb;
+}
+
 /******************************************
  *    Methods inherited from NetDevice    *
  ******************************************/
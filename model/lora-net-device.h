@@ -91,13 +91,33 @@ public:
    */
   bool Send (Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber);
 
+  /**
+   * Type definition for a callback for packets received by this device,
+   * together with the parameters of their reception.
+   */
+  typedef Callback<bool, Ptr<NetDevice>, Ptr<const Packet>,
+                   const LoraRxParameters &> LoraReceiveCallback;
+
   /**
    * Callback the Mac layer calls whenever a packet arrives and needs to be
    * forwarded up the stack.
    *
+   * If a LoraReceiveCallback was set, the reception parameters are passed to
+   * it alongside the packet. Otherwise, they are written in the packet's
+   * LoraTag before calling the NetDevice receive callback.
+   *
    * \param packet The packet that was received.
+   * \param rxParams The parameters of the reception.
    */
-  void Receive (Ptr<Packet> packet);
+  void Receive (Ptr<Packet> packet, const LoraRxParameters &rxParams);
+
+  /**
+   * Set the callback that gets packets received by this device together with
+   * the parameters of their reception.
+   *
+   * \param cb The callback.
+   */
+  void SetLoraReceiveCallback (LoraReceiveCallback cb);
 
   // From class NetDevice. Some of these have little meaning for a LoRaWAN
   // network device (since, for instance, IP is not used in the standard)
@@ -159,6 +179,12 @@ private:
    * Upper layer callback used for notification of new data packet arrivals.
    */
   NetDevice::ReceiveCallback m_receiveCallback;
+
+  /**
+   * Upper layer callback used for notification of new data packet arrivals,
+   * together with the parameters of their reception.
+   */
+  LoraReceiveCallback m_loraReceiveCallback;
 };
 
 } //namespace ns3
@@ -22,7 +22,10 @@
 #include "ns3/log.h"
 #include "ns3/simulator.h"
 #include "ns3/trace-source-accessor.h"
+#include "ns3/double.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace ns3 {
 namespace lorawan {
@@ -38,6 +41,21 @@ LoraPhy::GetTypeId (void)
       TypeId ("ns3::LoraPhy")
           .SetParent<Object> ()
           .SetGroupName ("lorawan")
+          .AddAttribute ("OldEventThreshold",
+                         "Time after the end of a signal after which it is no "
+                         "longer considered for interference computations",
+                         TimeValue (Seconds (2)),
+                         MakeTimeAccessor (&LoraPhy::SetOldEventThreshold,
+                                           &LoraPhy::GetOldEventThreshold),
+                         MakeTimeChecker ())
+          .AddAttribute ("InterferencePruningMarginDb",
+                         "Signals weaker than the lowest sensitivity of the "
+                         "device minus this margin are not considered as "
+                         "interferers. An infinite margin keeps all signals.",
+                         DoubleValue (std::numeric_limits<double>::infinity ()),
+                         MakeDoubleAccessor (&LoraPhy::SetInterferencePruningMargin,
+                                             &LoraPhy::GetInterferencePruningMargin),
+                         MakeDoubleChecker<double> (0, std::numeric_limits<double>::infinity ()))
           .AddTraceSource ("StartSending",
                            "Trace source indicating the PHY layer"
                            "has begun the sending process for a packet",
@@ -84,6 +102,7 @@ LoraPhy::GetTypeId (void)
 }
 
 LoraPhy::LoraPhy ()
+    : m_interferencePruningMarginDb (std::numeric_limits<double>::infinity ())
 {
 }
 
@@ -103,6 +122,12 @@ LoraPhy::SetDevice (Ptr<NetDevice> device)
   NS_LOG_FUNCTION (this << device);
 
   m_device = device;
+
+  // The channel takes our context from the device's node
+  if (m_channel != 0)
+    {
+      m_channel->InvalidateReceiverTable ();
+    }
 }
 
 Ptr<LoraChannel>
@@ -136,6 +161,11 @@ LoraPhy::SetMobility (Ptr<MobilityModel> mobility)
   NS_LOG_FUNCTION_NOARGS ();
 
   m_mobility = mobility;
+
+  if (m_channel != 0)
+    {
+      m_channel->InvalidateReceiverTable ();
+    }
 }
 
 void
@@ -146,6 +176,54 @@ LoraPhy::SetChannel (Ptr<LoraChannel> channel)
   m_channel = channel;
 }
 
+void
+LoraPhy::UpdateFrequencySubscription (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_channel != 0)
+    {
+      m_channel->UpdateFrequencySubscription (this);
+    }
+}
+
+void
+LoraPhy::SetOldEventThreshold (Time threshold)
+{
+  NS_LOG_FUNCTION (this << threshold);
+
+  m_interference.SetOldEventThreshold (threshold);
+}
+
+Time
+LoraPhy::GetOldEventThreshold (void) const
+{
+  return m_interference.GetOldEventThreshold ();
+}
+
+void
+LoraPhy::SetInterferencePruningMargin (double marginDb)
+{
+  NS_LOG_FUNCTION (this << marginDb);
+
+  m_interferencePruningMarginDb = marginDb;
+  m_interference.SetPruningFloor (GetMinSensitivity () - marginDb);
+}
+
+double
+LoraPhy::GetInterferencePruningMargin (void) const
+{
+  return m_interferencePruningMarginDb;
+}
+
+void
+LoraPhy::SetInterferenceLedger (const LoraInterferenceHelper *ledger, uint32_t receiverId)
+{
+  NS_LOG_FUNCTION (this << ledger << receiverId);
+
+  m_interference.SetLedger (ledger, receiverId);
+}
+
 void
 LoraPhy::SetReceiveOkCallback (RxOkCallback callback)
 {
@@ -171,6 +249,80 @@ LoraPhy::GetOnAirTime (Ptr<Packet> packet, LoraTxParameters txParams)
 
   NS_LOG_FUNCTION (packet << txParams);
 
+  // Only the spreading factors and bandwidths used by LoRaWAN are tabulated
+  uint32_t payloadSize = packet->GetSize ();
+  if (txParams.sf >= 7 && txParams.sf <= 12)
+    {
+      if (txParams.bandwidthHz == 125000)
+        {
+          return GetTabulatedOnAirTime (payloadSize, txParams, txParams.sf - 7, 0);
+        }
+      else if (txParams.bandwidthHz == 250000)
+        {
+          return GetTabulatedOnAirTime (payloadSize, txParams, txParams.sf - 7, 1);
+        }
+      else if (txParams.bandwidthHz == 500000)
+        {
+          return GetTabulatedOnAirTime (payloadSize, txParams, txParams.sf - 7, 2);
+        }
+    }
+
+  return ComputeOnAirTime (payloadSize, txParams);
+}
+
+double
+LoraPhy::GetSnr (double rxPowerDbm, double bandwidthHz)
+{
+  // Thermal noise is -174 dBm/Hz
+  return rxPowerDbm + 174 - 10 * std::log10 (bandwidthHz) - 6;
+}
+
+std::vector<std::unique_ptr<int64_t[]> > &
+LoraPhy::GetOnAirTimeTable (void)
+{
+  // 6 spreading factors, 3 bandwidths, 4 coding rates, 16 preamble lengths
+  // and 8 combinations of the header, CRC and low data rate flags
+  static std::vector<std::unique_ptr<int64_t[]> > table (6 * 3 * 4 * 16 * 8);
+  return table;
+}
+
+Time
+LoraPhy::GetTabulatedOnAirTime (uint32_t payloadSize,
+                                const LoraTxParameters &txParams,
+                                uint32_t sfIndex, uint32_t bandwidthIndex)
+{
+  if (payloadSize > 255 || txParams.codingRate < 1 || txParams.codingRate > 4
+      || txParams.nPreamble > 15)
+    {
+      return ComputeOnAirTime (payloadSize, txParams);
+    }
+
+  uint32_t flags = txParams.headerDisabled | (txParams.crcEnabled << 1) |
+    (txParams.lowDataRateOptimizationEnabled << 2);
+  uint32_t block = (((sfIndex * 3 + bandwidthIndex) * 4 +
+                     (txParams.codingRate - 1)) * 16 + txParams.nPreamble) * 8 + flags;
+
+  std::unique_ptr<int64_t[]> &entries = GetOnAirTimeTable ()[block];
+  if (!entries)
+    {
+      entries.reset (new int64_t[256]);
+      std::fill (entries.get (), entries.get () + 256, -1);
+    }
+
+  int64_t &entry = entries[payloadSize];
+  if (entry < 0)
+    {
+      entry = ComputeOnAirTime (payloadSize, txParams).GetTimeStep ();
+    }
+
+  return TimeStep (entry);
+}
+
+Time
+LoraPhy::ComputeOnAirTime (uint32_t payloadSize, const LoraTxParameters &txParams)
+{
+  NS_LOG_FUNCTION (payloadSize << txParams);
+
   // The contents of this function are based on [1].
   // [1] SX1272 LoRa modem designer's guide.
 
@@ -182,7 +334,7 @@ LoraPhy::GetOnAirTime (Ptr<Packet> packet, LoraTxParameters txParams)
   double tPreamble = (double(txParams.nPreamble) + 4.25) * tSym;
 
   // Payload size
-  uint32_t pl = packet->GetSize ();      // Size in bytes
+  uint32_t pl = payloadSize;      // Size in bytes
   NS_LOG_DEBUG ("Packet of size " << pl << " bytes");
 
   // This step is needed since the formula deals with double values.
@@ -220,6 +372,21 @@ std::ostream &operator << (std::ostream &os, const LoraTxParameters &params)
     ", nPreamble: " << params.nPreamble <<
     ", crcEnabled: " << params.crcEnabled <<
     ", lowDataRateOptimizationEnabled: " << params.lowDataRateOptimizationEnabled <<
+    ", invertedIq: " << params.invertedIq <<
+    ")";
+
+  return os;
+}
+
+std::ostream &operator << (std::ostream &os, const LoraRxParameters &params)
+{
+  os << "rxPowerDbm: " << params.rxPowerDbm <<
+    ", snrDb: " << params.snrDb <<
+    ", SF: " << unsigned(params.sf) <<
+    ", frequencyMHz: " << params.frequencyMHz <<
+    ", gatewayId: " << params.gatewayId <<
+    ", startTime: " << params.startTime.GetSeconds () <<
+    ", endTime: " << params.endTime.GetSeconds () <<
     ")";
 
   return os;
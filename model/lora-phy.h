@@ -33,6 +33,8 @@
 #include "ns3/traced-callback.h"
 #include "ns3/traced-value.h"
 #include <list>
+#include <memory>
+#include <vector>
 
 namespace ns3 {
 namespace lorawan {
@@ -52,6 +54,7 @@ struct LoraTxParameters
   uint32_t nPreamble = 8;     //!< Number of preamble symbols
   bool crcEnabled = 1;     //!< Whether Cyclic Redundancy Check is enabled
   bool lowDataRateOptimizationEnabled = 0;     //!< Whether Low Data Rate Optimization is enabled
+  bool invertedIq = 0;     //!< Whether IQ signals are inverted, as in downlink
 };
 
 /**
@@ -59,6 +62,29 @@ struct LoraTxParameters
  */
 std::ostream &operator << (std::ostream &os, const LoraTxParameters &params);
 
+/**
+ * Structure describing a single reception of a packet at a PHY layer.
+ *
+ * Since the channel delivers the same packet to every receiver, the
+ * information that is specific to a reception travels alongside the packet
+ * instead of inside its tags.
+ */
+struct LoraRxParameters
+{
+  double rxPowerDbm = 0;     //!< Power of the received packet, in dBm
+  double snrDb = 0;     //!< Signal to noise ratio of the received packet, in dB
+  uint8_t sf = 0;     //!< Spreading Factor of the received packet
+  double frequencyMHz = 0;     //!< Frequency the packet was received on
+  uint32_t gatewayId = 0;     //!< Id of the node of the receiving gateway
+  Time startTime;     //!< Time the reception started
+  Time endTime;     //!< Time the reception ended
+};
+
+/**
+ * Allow logging of LoraRxParameters like with any other data type.
+ */
+std::ostream &operator << (std::ostream &os, const LoraRxParameters &params);
+
 /**
  * \ingroup lorawan
  *
@@ -86,9 +112,10 @@ public:
    * Type definition for a callback for when a packet is correctly received.
    *
    * This callback can be set by an upper layer that wishes to be informed of
-   * correct reception events.
+   * correct reception events. Together with the packet, the callback gets the
+   * parameters of this specific reception.
    */
-  typedef Callback<void, Ptr<const Packet> > RxOkCallback;
+  typedef Callback<void, Ptr<const Packet>, const LoraRxParameters &> RxOkCallback;
 
   /**
    * Type definition for a callback for when a packet reception fails.
@@ -121,10 +148,11 @@ public:
    * \param sf The Spreading Factor of the arriving packet.
    * \param duration The on air time of this packet.
    * \param frequencyMHz The frequency this packet is being transmitted on.
+   * \param bandwidthHz The bandwidth of the arriving packet, in Hz.
    */
   virtual void StartReceive (Ptr<Packet> packet, double rxPowerDbm,
                              uint8_t sf, Time duration,
-                             double frequencyMHz) = 0;
+                             double frequencyMHz, double bandwidthHz) = 0;
 
   /**
    * Finish reception of a packet.
@@ -172,6 +200,31 @@ public:
    */
   virtual bool IsOnFrequency (double frequency) = 0;
 
+  /**
+   * Get the lowest power at which this device can receive a packet, with any
+   * spreading factor.
+   *
+   * \return The sensitivity in dBm.
+   */
+  virtual double GetMinSensitivity (void) const = 0;
+
+  /**
+   * Whether this device demodulates signals with inverted IQ.
+   *
+   * In LoRaWAN, downlink transmissions use inverted IQ, so that end devices
+   * only listen to gateways and gateways only listen to end devices.
+   *
+   * \return true if the device listens to inverted IQ signals.
+   */
+  virtual bool IsListeningInvertedIq (void) const = 0;
+
+  /**
+   * Get the frequencies this device is currently able to receive on.
+   *
+   * \return The frequencies, in MHz.
+   */
+  virtual std::vector<double> GetListeningFrequencies (void) const = 0;
+
   /**
    * Set the callback to call upon successful reception of a packet.
    *
@@ -227,6 +280,48 @@ public:
    */
   Ptr<LoraChannel> GetChannel (void) const;
 
+  /**
+   * Set the time after the end of a signal after which it is no longer
+   * considered for interference computations.
+   *
+   * \param threshold The new threshold.
+   */
+  void SetOldEventThreshold (Time threshold);
+
+  /**
+   * Get the time after the end of a signal after which it is no longer
+   * considered for interference computations.
+   */
+  Time GetOldEventThreshold (void) const;
+
+  /**
+   * Set how far below the sensitivity of this device a signal must be for it
+   * to be ignored as an interferer.
+   *
+   * Signals weaker than the lowest sensitivity minus this margin are not
+   * stored by the interference helper. An infinite margin keeps all signals.
+   *
+   * \param marginDb The margin in dB.
+   */
+  void SetInterferencePruningMargin (double marginDb);
+
+  /**
+   * Get how far below the sensitivity of this device a signal must be for it
+   * to be ignored as an interferer.
+   */
+  double GetInterferencePruningMargin (void) const;
+
+  /**
+   * Make this PHY look up interferers in a ledger shared by all receivers of
+   * the channel, instead of keeping its own copy of each signal.
+   *
+   * This is typically called by the LoraChannel this PHY is connected to.
+   *
+   * \param ledger The ledger, or 0 to keep track of signals locally.
+   * \param receiverId The id of this PHY in the ledger.
+   */
+  void SetInterferenceLedger (const LoraInterferenceHelper *ledger, uint32_t receiverId);
+
   /**
    * Get the NetDevice associated to this PHY.
    *
@@ -255,10 +350,88 @@ public:
    */
   static Time GetOnAirTime (Ptr<Packet> packet, LoraTxParameters txParams);
 
+  /**
+   * Compute the signal to noise ratio of a reception.
+   *
+   * The noise floor is the thermal noise over the bandwidth of the signal,
+   * plus a 6 dB noise figure.
+   *
+   * \param rxPowerDbm The received power, in dBm.
+   * \param bandwidthHz The bandwidth of the signal, in Hz.
+   * \return The signal to noise ratio, in dB.
+   */
+  static double GetSnr (double rxPowerDbm, double bandwidthHz);
+
+  /**
+   * Compute the time that a packet will take to be transmitted, for callers
+   * that know the spreading factor and bandwidth at compile time.
+   *
+   * The sf and bandwidthHz fields of txParams are ignored.
+   *
+   * \tparam sf The spreading factor, between 7 and 12.
+   * \tparam bandwidthHz The bandwidth, either 125, 250 or 500 kHz.
+   * \param packet The packet that needs to be transmitted.
+   * \param txParams The set of parameters that will be used for transmission.
+   * \return The time necessary to transmit the packet.
+   */
+  template <uint8_t sf, uint32_t bandwidthHz>
+  static Time GetOnAirTime (Ptr<Packet> packet, LoraTxParameters txParams)
+  {
+    static_assert (sf >= 7 && sf <= 12, "Unsupported spreading factor");
+    static_assert (bandwidthHz == 125000 || bandwidthHz == 250000 ||
+                   bandwidthHz == 500000, "Unsupported bandwidth");
+
+    txParams.sf = sf;
+    txParams.bandwidthHz = bandwidthHz;
+    return GetTabulatedOnAirTime (packet->GetSize (), txParams, sf - 7,
+                                  bandwidthHz == 125000 ? 0 :
+                                  (bandwidthHz == 250000 ? 1 : 2));
+  }
+
 private:
+  /**
+   * Compute the time on air of a packet.
+   *
+   * \param payloadSize The size of the packet, in bytes.
+   * \param txParams The set of parameters that will be used for transmission.
+   * \return The time necessary to transmit the packet.
+   */
+  static Time ComputeOnAirTime (uint32_t payloadSize,
+                                const LoraTxParameters &txParams);
+
+  /**
+   * Get the time on air of a packet from the table of already computed
+   * values, filling it if needed. Packets whose parameters are not covered by
+   * the table are computed with ComputeOnAirTime.
+   *
+   * \param payloadSize The size of the packet, in bytes.
+   * \param txParams The set of parameters that will be used for transmission.
+   * \param sfIndex The index of the spreading factor, starting from SF7.
+   * \param bandwidthIndex The index of the bandwidth, starting from 125 kHz.
+   * \return The time necessary to transmit the packet.
+   */
+  static Time GetTabulatedOnAirTime (uint32_t payloadSize,
+                                     const LoraTxParameters &txParams,
+                                     uint32_t sfIndex, uint32_t bandwidthIndex);
+
+  /**
+   * Get the table of the time on air of packets, in time steps. The table
+   * has one block of entries per combination of spreading factor, bandwidth,
+   * coding rate, preamble length and flags, with one entry per payload size.
+   * Blocks are allocated the first time they are used, and entries that were
+   * not computed yet are negative.
+   */
+  static std::vector<std::unique_ptr<int64_t[]> > &GetOnAirTimeTable (void);
+
   Ptr<MobilityModel> m_mobility;   //!< The mobility model associated to this PHY.
 
 protected:
+  /**
+   * Let the channel know that the frequencies returned by
+   * GetListeningFrequencies changed.
+   */
+  void UpdateFrequencySubscription (void);
+
   // Member objects
 
   Ptr<NetDevice> m_device; //!< The net device this PHY is attached to.
@@ -268,6 +441,9 @@ protected:
   LoraInterferenceHelper m_interference; //!< The LoraInterferenceHelper
   //!associated to this PHY.
 
+  double m_interferencePruningMarginDb; //!< Margin below sensitivity under
+  //!which signals are ignored as interferers.
+
   // Trace sources
 
   /**
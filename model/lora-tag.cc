@@ -135,13 +135,13 @@ LoraTag::SetFrequency (double frequency)
 }
 
 double
-LoraTag::GetFrequency (void)
+LoraTag::GetFrequency (void) const
 {
   return m_frequency;
 }
 
 uint8_t
-LoraTag::GetDataRate (void)
+LoraTag::GetDataRate (void) const
 {
   return m_dataRate;
 }
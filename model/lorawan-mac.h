@@ -74,8 +74,10 @@ public:
    * Receive a packet from the lower layer.
    *
    * \param packet the received packet
+   * \param rxParams the parameters of this reception
    */
-  virtual void Receive (Ptr<Packet const> packet) = 0;
+  virtual void Receive (Ptr<Packet const> packet,
+                        const LoraRxParameters &rxParams) = 0;
 
   /**
    * Function called by lower layers to inform this layer that reception of a
@@ -66,19 +66,15 @@ ConfirmedMessagesComponent::~ConfirmedMessagesComponent ()
 }
 
 void
-ConfirmedMessagesComponent::OnReceivedPacket (Ptr<const Packet> packet,
+ConfirmedMessagesComponent::OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame,
                                               Ptr<EndDeviceStatus> status,
                                               Ptr<NetworkStatus> networkStatus)
 {
-  NS_LOG_FUNCTION (this->GetTypeId () << packet << networkStatus);
+  NS_LOG_FUNCTION (this->GetTypeId () << frame.packet << networkStatus);
 
   // Check whether the received packet requires an acknowledgment.
-  LorawanMacHeader mHdr;
-  LoraFrameHeader fHdr;
-  fHdr.SetAsUplink ();
-  Ptr<Packet> myPacket = packet->Copy ();
-  myPacket->RemoveHeader (mHdr);
-  myPacket->RemoveHeader (fHdr);
+  const LorawanMacHeader &mHdr = frame.macHeader;
+  const LoraFrameHeader &fHdr = frame.frameHeader;
 
   NS_LOG_INFO ("Received packet Mac Header: " << mHdr);
   NS_LOG_INFO ("Received packet Frame Header: " << fHdr);
@@ -143,11 +139,11 @@ LinkCheckComponent::~LinkCheckComponent ()
 }
 
 void
-LinkCheckComponent::OnReceivedPacket (Ptr<const Packet> packet,
+LinkCheckComponent::OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame,
                                       Ptr<EndDeviceStatus> status,
                                       Ptr<NetworkStatus> networkStatus)
 {
-  NS_LOG_FUNCTION (this->GetTypeId () << packet << networkStatus);
+  NS_LOG_FUNCTION (this->GetTypeId () << frame.packet << networkStatus);
 
   // We will only act just before reply, when all Gateways will have received
   // the packet.
@@ -159,12 +155,7 @@ LinkCheckComponent::BeforeSendingReply (Ptr<EndDeviceStatus> status,
 {
   NS_LOG_FUNCTION (this << status << networkStatus);
 
-  Ptr<Packet> myPacket = status->GetLastPacketReceivedFromDevice ()->Copy ();
-  LorawanMacHeader mHdr;
-  LoraFrameHeader fHdr;
-  fHdr.SetAsUplink ();
-  myPacket->RemoveHeader (mHdr);
-  myPacket->RemoveHeader (fHdr);
+  const LoraFrameHeader &fHdr = status->GetLastFrameHeaderReceivedFromDevice ();
 
   Ptr<LinkCheckReq> command = fHdr.GetMacCommand<LinkCheckReq> ();
 
@@ -60,20 +60,20 @@ NetworkController::Install (Ptr<NetworkControllerComponent> component)
 }
 
 void
-NetworkController::OnNewPacket (Ptr<Packet const> packet)
+NetworkController::OnNewPacket (const EndDeviceStatus::UplinkFrame &frame)
 {
-  NS_LOG_FUNCTION (this << packet);
+  NS_LOG_FUNCTION (this << frame.packet);
 
   // NOTE As a future optimization, we can allow components to register their
   // callbacks and only be called in case a certain MAC command is contained.
   // For now, we call all components.
 
   // Inform each component about the new packet
+  Ptr<EndDeviceStatus> status =
+    m_status->GetEndDeviceStatus (frame.frameHeader.GetAddress ());
   for (auto it = m_components.begin (); it != m_components.end (); ++it)
     {
-      (*it)->OnReceivedPacket (packet,
-                               m_status->GetEndDeviceStatus (packet),
-                               m_status);
+      (*it)->OnReceivedPacket (frame, status, m_status);
     }
 }
 
@@ -54,9 +54,9 @@ public:
   /**
    * Method that is called by the NetworkServer when a new packet is received.
    *
-   * \param packet The newly received packet.
+   * \param frame The newly received packet, with its parsed headers.
    */
-  void OnNewPacket (Ptr<Packet const> packet);
+  void OnNewPacket (const EndDeviceStatus::UplinkFrame &frame);
 
   /**
    * Method that is called by the NetworkScheduler just before sending a reply
@@ -37,31 +37,21 @@ NetworkScheduler::~NetworkScheduler ()
 }
 
 void
-NetworkScheduler::OnReceivedPacket (Ptr<const Packet> packet)
+NetworkScheduler::OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame)
 {
-  NS_LOG_FUNCTION (packet);
+  NS_LOG_FUNCTION (frame.packet);
 
   // Get the current packet's frame counter
-  Ptr<Packet> packetCopy = packet->Copy ();
-  LorawanMacHeader receivedMacHdr;
-  packetCopy->RemoveHeader (receivedMacHdr);
-  LoraFrameHeader receivedFrameHdr;
-  receivedFrameHdr.SetAsUplink ();
-  packetCopy->RemoveHeader (receivedFrameHdr);
+  const LoraFrameHeader &receivedFrameHdr = frame.frameHeader;
   uint8_t currentFrameCounter = receivedFrameHdr.GetFCnt ();
 
   // Get the saved packet's frame counter
-  Ptr<const Packet> savedPacket = m_status->GetEndDeviceStatus
-      (packet)->GetLastReceivedPacketInfo ().packet;
-  if (savedPacket)
+  Ptr<EndDeviceStatus> status =
+    m_status->GetEndDeviceStatus (receivedFrameHdr.GetAddress ());
+  if (status->GetLastPacketReceivedFromDevice ())
     {
-      Ptr<Packet> savedPacketCopy = savedPacket->Copy ();
-      LorawanMacHeader savedMacHdr;
-      savedPacketCopy->RemoveHeader (savedMacHdr);
-      LoraFrameHeader savedFrameHdr;
-      savedFrameHdr.SetAsUplink ();
-      savedPacketCopy->RemoveHeader (savedFrameHdr);
-      uint8_t savedFrameCounter = savedFrameHdr.GetFCnt ();
+      uint8_t savedFrameCounter =
+        status->GetLastFrameHeaderReceivedFromDevice ().GetFCnt ();
 
       if (currentFrameCounter == savedFrameCounter)
         {
@@ -50,8 +50,10 @@ public:
    * Method called by NetworkServer to inform the Scheduler of a newly arrived
    * uplink packet. This function schedules the OnReceiveWindowOpportunity
    * events 1 and 2 seconds later.
+   *
+   * \param frame The newly received packet, with its parsed headers.
    */
-  void OnReceivedPacket (Ptr<const Packet> packet);
+  void OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame);
 
   /**
    * Method that is scheduled after packet arrivals in order to act on
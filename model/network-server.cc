@@ -165,20 +165,26 @@ NetworkServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
 {
   NS_LOG_FUNCTION (this << packet << protocol << address);
 
-  // Create a copy of the packet
+  // Deserialize the headers once, for all the components that need them
+  EndDeviceStatus::UplinkFrame frame;
+  frame.packet = packet;
   Ptr<Packet> myPacket = packet->Copy ();
+  myPacket->RemoveHeader (frame.macHeader);
+  frame.frameHeader.SetAsUplink ();
+  myPacket->RemoveHeader (frame.frameHeader);
+  packet->PeekPacketTag (frame.tag);
 
   // Fire the trace source
   m_receivedPacket (packet);
 
   // Inform the scheduler of the newly arrived packet
-  m_scheduler->OnReceivedPacket (packet);
+  m_scheduler->OnReceivedPacket (frame);
 
   // Inform the status of the newly arrived packet
-  m_status->OnReceivedPacket (packet, address);
+  m_status->OnReceivedPacket (frame, address);
 
   // Inform the controller of the newly arrived packet
-  m_controller->OnNewPacket (packet);
+  m_controller->OnNewPacket (frame);
 
   return true;
 }
@@ -98,25 +98,15 @@ NetworkStatus::AddGateway (Address& address, Ptr<GatewayStatus> gwStatus)
 }
 
 void
-NetworkStatus::OnReceivedPacket (Ptr<const Packet> packet,
-                                  const Address& gwAddress)
+NetworkStatus::OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame,
+                                 const Address& gwAddress)
 {
-  NS_LOG_FUNCTION (this << packet << gwAddress);
-
-  // Create a copy of the packet
-  Ptr<Packet> myPacket = packet->Copy ();
-
-  // Extract the headers
-  LorawanMacHeader macHdr;
-  myPacket->RemoveHeader (macHdr);
-  LoraFrameHeader frameHdr;
-  frameHdr.SetAsUplink ();
-  myPacket->RemoveHeader (frameHdr);
+  NS_LOG_FUNCTION (this << frame.packet << gwAddress);
 
   // Update the correct EndDeviceStatus object
-  LoraDeviceAddress edAddr = frameHdr.GetAddress ();
+  LoraDeviceAddress edAddr = frame.frameHeader.GetAddress ();
   NS_LOG_DEBUG ("Node address: " << edAddr);
-  m_endDeviceStatuses.at (edAddr)->InsertReceivedPacket (packet, gwAddress);
+  m_endDeviceStatuses.at (edAddr)->InsertReceivedPacket (frame, gwAddress);
 }
 
 bool
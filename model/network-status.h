@@ -67,10 +67,11 @@ public:
   /**
    * Update network status on the received packet.
    *
-   * \param packet the received packet.
+   * \param frame the received packet, with its parsed headers.
    * \param address the gateway this packet was received from.
    */
-  void OnReceivedPacket (Ptr<const Packet> packet, const Address &gwaddress);
+  void OnReceivedPacket (const EndDeviceStatus::UplinkFrame &frame,
+                         const Address &gwaddress);
 
   /**
    * Return whether the specified device needs a reply.
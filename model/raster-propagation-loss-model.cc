@@ -0,0 +1,230 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/raster-propagation-loss-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/pointer.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("RasterPropagationLossModel");
+
+NS_OBJECT_ENSURE_REGISTERED (RasterPropagationLossModel);
+
+TypeId
+RasterPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RasterPropagationLossModel")
+    .SetParent<PropagationLossModel> ()
+    .SetGroupName ("Lora")
+    .AddConstructor<RasterPropagationLossModel> ()
+    .AddAttribute ("Model",
+                   "The loss model chain to rasterize",
+                   PointerValue (),
+                   MakePointerAccessor (&RasterPropagationLossModel::SetModel,
+                                        &RasterPropagationLossModel::GetModel),
+                   MakePointerChecker<PropagationLossModel> ())
+    .AddAttribute ("Area",
+                   "The area covered by the rasters",
+                   BoxValue (Box ()),
+                   MakeBoxAccessor (&RasterPropagationLossModel::m_area),
+                   MakeBoxChecker ())
+    .AddAttribute ("Resolution",
+                   "The distance between two raster points, in meters",
+                   DoubleValue (10),
+                   MakeDoubleAccessor (&RasterPropagationLossModel::m_resolution),
+                   MakeDoubleChecker<double> (std::numeric_limits<double>::min ()))
+    .AddAttribute ("Height",
+                   "The height of the raster points, in meters. The height of "
+                   "the other end of a rasterized link is ignored.",
+                   DoubleValue (1.2),
+                   MakeDoubleAccessor (&RasterPropagationLossModel::m_height),
+                   MakeDoubleChecker<double> ());
+  return tid;
+}
+
+RasterPropagationLossModel::RasterPropagationLossModel ()
+{
+  NS_LOG_FUNCTION_NOARGS ();
+}
+
+RasterPropagationLossModel::~RasterPropagationLossModel ()
+{
+  NS_LOG_FUNCTION_NOARGS ();
+}
+
+void
+RasterPropagationLossModel::SetModel (Ptr<PropagationLossModel> model)
+{
+  NS_LOG_FUNCTION (this << model);
+
+  m_model = model;
+
+  // Rasters of the previous model are no longer valid
+  for (std::vector<Raster>::iterator it = m_rasters.begin ();
+       it != m_rasters.end (); ++it)
+    {
+      it->uplinkGain.clear ();
+      it->downlinkGain.clear ();
+    }
+}
+
+Ptr<PropagationLossModel>
+RasterPropagationLossModel::GetModel (void) const
+{
+  return m_model;
+}
+
+void
+RasterPropagationLossModel::AddStaticNode (Ptr<MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+
+  if (m_rasterIndex.find (PeekPointer (mobility)) != m_rasterIndex.end ())
+    {
+      return;
+    }
+
+  m_rasterIndex[PeekPointer (mobility)] = m_rasters.size ();
+  Raster raster;
+  raster.node = mobility;
+  m_rasters.push_back (raster);
+}
+
+double
+RasterPropagationLossModel::DoCalcRxPower (double txPowerDbm,
+                                           Ptr<MobilityModel> a,
+                                           Ptr<MobilityModel> b) const
+{
+  NS_LOG_FUNCTION (this << txPowerDbm << a << b);
+
+  NS_ASSERT_MSG (m_model != 0, "No loss model to rasterize was set");
+
+  double gainDb;
+
+  // Links towards a static node
+  std::unordered_map<const MobilityModel *, uint32_t>::const_iterator it =
+    m_rasterIndex.find (PeekPointer (b));
+  if (it != m_rasterIndex.end ())
+    {
+      if (GetGain (m_rasters[it->second], true, a->GetPosition (), gainDb))
+        {
+          return txPowerDbm + gainDb;
+        }
+      return m_model->CalcRxPower (txPowerDbm, a, b);
+    }
+
+  // Links from a static node
+  it = m_rasterIndex.find (PeekPointer (a));
+  if (it != m_rasterIndex.end ())
+    {
+      if (GetGain (m_rasters[it->second], false, b->GetPosition (), gainDb))
+        {
+          return txPowerDbm + gainDb;
+        }
+    }
+
+  return m_model->CalcRxPower (txPowerDbm, a, b);
+}
+
+int64_t
+RasterPropagationLossModel::DoAssignStreams (int64_t stream)
+{
+  if (m_model != 0)
+    {
+      return m_model->AssignStreams (stream);
+    }
+  return 0;
+}
+
+void
+RasterPropagationLossModel::BuildRaster (Raster &raster, bool uplink) const
+{
+  NS_LOG_FUNCTION (this << raster.node << uplink);
+
+  uint32_t nx = static_cast<uint32_t> (std::ceil ((m_area.xMax - m_area.xMin) / m_resolution)) + 1;
+  uint32_t ny = static_cast<uint32_t> (std::ceil ((m_area.yMax - m_area.yMin) / m_resolution)) + 1;
+
+  NS_LOG_DEBUG ("Computing a " << nx << "x" << ny << " raster for node " <<
+                raster.node->GetPosition ());
+
+  std::vector<double> &gain = uplink ? raster.uplinkGain : raster.downlinkGain;
+  gain.resize (nx * ny);
+
+  // Move a probe over the raster points
+  Ptr<ConstantPositionMobilityModel> probe =
+    CreateObject<ConstantPositionMobilityModel> ();
+  for (uint32_t y = 0; y < ny; y++)
+    {
+      for (uint32_t x = 0; x < nx; x++)
+        {
+          probe->SetPosition (Vector (m_area.xMin + x * m_resolution,
+                                      m_area.yMin + y * m_resolution,
+                                      m_height));
+          gain[y * nx + x] = uplink ?
+            m_model->CalcRxPower (0, probe, raster.node) :
+            m_model->CalcRxPower (0, raster.node, probe);
+        }
+    }
+}
+
+bool
+RasterPropagationLossModel::GetGain (Raster &raster, bool uplink,
+                                     const Vector &position, double &gainDb) const
+{
+  if (position.x < m_area.xMin || position.x > m_area.xMax ||
+      position.y < m_area.yMin || position.y > m_area.yMax)
+    {
+      NS_LOG_DEBUG ("Position " << position << " is outside the raster");
+      return false;
+    }
+
+  uint32_t nx = static_cast<uint32_t> (std::ceil ((m_area.xMax - m_area.xMin) / m_resolution)) + 1;
+  uint32_t ny = static_cast<uint32_t> (std::ceil ((m_area.yMax - m_area.yMin) / m_resolution)) + 1;
+  if (nx < 2 || ny < 2)
+    {
+      return false;
+    }
+
+  std::vector<double> &gain = uplink ? raster.uplinkGain : raster.downlinkGain;
+  if (gain.empty ())
+    {
+      BuildRaster (raster, uplink);
+    }
+
+  // Find the raster square the position is in, and the position inside it
+  double fx = (position.x - m_area.xMin) / m_resolution;
+  double fy = (position.y - m_area.yMin) / m_resolution;
+  uint32_t x = std::min (static_cast<uint32_t> (fx), nx - 2);
+  uint32_t y = std::min (static_cast<uint32_t> (fy), ny - 2);
+  double dx = fx - x;
+  double dy = fy - y;
+
+  const double *lower = &gain[y * nx + x];
+  const double *upper = lower + nx;
+  gainDb = (1 - dy) * ((1 - dx) * lower[0] + dx * lower[1]) +
+    dy * ((1 - dx) * upper[0] + dx * upper[1]);
+
+  return true;
+}
+}
+}
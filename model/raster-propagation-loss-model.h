@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RASTER_PROPAGATION_LOSS_MODEL_H
+#define RASTER_PROPAGATION_LOSS_MODEL_H
+
+#include "ns3/propagation-loss-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/box.h"
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+class MobilityModel;
+namespace lorawan {
+
+/**
+ * A propagation loss model that precomputes, for each static node (i.e., a
+ * gateway), a raster of the gain of another loss model chain over the
+ * deployment area.
+ *
+ * The gain between a static node and any position in the area is then the
+ * bilinear interpolation of the 4 raster points around the position, instead
+ * of an evaluation of the whole chain. This works for mobile end devices too,
+ * and takes O(static nodes x raster points) memory.
+ *
+ * Raster points all lie at the height given by the Height attribute, so the
+ * z coordinate of the other end of a rasterized link is ignored: an end
+ * device is treated as if it were at that height.
+ *
+ * The rasterized chain must attenuate the transmission power by an amount
+ * that only depends on the positions of the two ends, such as a
+ * LogDistancePropagationLossModel followed by a
+ * CorrelatedShadowingPropagationLossModel. Models that depend on the nodes
+ * themselves, like BuildingPenetrationLoss, should be set as the next model
+ * of this one instead. Links that don't involve a static node, or whose
+ * other end is outside the area, are evaluated with the chain.
+ */
+class RasterPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  RasterPropagationLossModel ();
+
+  ~RasterPropagationLossModel ();
+
+  /**
+   * Set the loss model chain to rasterize.
+   */
+  void SetModel (Ptr<PropagationLossModel> model);
+
+  /**
+   * Get the loss model chain that is rasterized.
+   */
+  Ptr<PropagationLossModel> GetModel (void) const;
+
+  /**
+   * Add a node that never moves, whose links will be computed using a
+   * raster. Rasters are computed the first time they are needed.
+   *
+   * \param mobility The mobility model of the node.
+   */
+  void AddStaticNode (Ptr<MobilityModel> mobility);
+
+private:
+  virtual double DoCalcRxPower (double txPowerDbm,
+                                Ptr<MobilityModel> a,
+                                Ptr<MobilityModel> b) const;
+
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  /**
+   * The rasters of a static node.
+   */
+  struct Raster
+  {
+    Ptr<MobilityModel> node;          //!< The mobility model of the node
+    std::vector<double> uplinkGain;   //!< The gain towards the node
+    std::vector<double> downlinkGain; //!< The gain from the node
+  };
+
+  /**
+   * Compute the gain between a static node and each point of the raster.
+   *
+   * \param raster The rasters of the static node.
+   * \param uplink Whether to compute the gain towards the node, or from it.
+   */
+  void BuildRaster (Raster &raster, bool uplink) const;
+
+  /**
+   * Interpolate the gain between a static node and a position.
+   *
+   * \param raster The rasters of the static node.
+   * \param uplink Whether the position transmits to the node, or vice versa.
+   * \param position The position of the other end of the link.
+   * \param gainDb Set to the interpolated gain, in dB.
+   * \return Whether the position is inside the area.
+   */
+  bool GetGain (Raster &raster, bool uplink, const Vector &position,
+                double &gainDb) const;
+
+  Ptr<PropagationLossModel> m_model; //!< The rasterized chain
+  Box m_area;                        //!< The area covered by the rasters
+  double m_resolution;               //!< The distance between raster points
+  double m_height;                   //!< The height of the raster points
+
+  /**
+   * The rasters of each static node, in the order they were added.
+   */
+  mutable std::vector<Raster> m_rasters;
+
+  /**
+   * The index in m_rasters of each static node.
+   */
+  std::unordered_map<const MobilityModel *, uint32_t> m_rasterIndex;
+};
+
+} // namespace lorawan
+
+} // namespace ns3
+#endif /* RASTER_PROPAGATION_LOSS_MODEL_H */
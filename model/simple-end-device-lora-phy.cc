@@ -122,11 +122,12 @@ SimpleEndDeviceLoraPhy::Send (Ptr<Packet> packet, LoraTxParameters txParams,
 
 void
 SimpleEndDeviceLoraPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
-                                      uint8_t sf, Time duration, double frequencyMHz)
+                                      uint8_t sf, Time duration, double frequencyMHz,
+                                      double bandwidthHz)
 {
 
   NS_LOG_FUNCTION (this << packet << rxPowerDbm << unsigned (sf) << duration <<
-                   frequencyMHz);
+                   frequencyMHz << bandwidthHz);
 
   // Notify the LoraInterferenceHelper of the impinging signal, and remember
   // the event it creates. This will be used then to correctly handle the end
@@ -138,6 +139,7 @@ SimpleEndDeviceLoraPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
 
   Ptr<LoraInterferenceHelper::Event> event;
   event = m_interference.Add (duration, rxPowerDbm, sf, packet, frequencyMHz);
+  event->SetBandwidth (bandwidthHz);
 
   // Switch on the current PHY state
   switch (m_state)
@@ -350,7 +352,15 @@ SimpleEndDeviceLoraPhy::EndReceive (Ptr<Packet> packet,
       // If there is one, perform the callback to inform the upper layer
       if (!m_rxOkCallback.IsNull ())
         {
-          m_rxOkCallback (packet);
+          LoraRxParameters rxParams;
+          rxParams.rxPowerDbm = event->GetRxPowerdBm ();
+          rxParams.snrDb = GetSnr (rxParams.rxPowerDbm, event->GetBandwidth ());
+          rxParams.sf = event->GetSpreadingFactor ();
+          rxParams.frequencyMHz = event->GetFrequency ();
+          rxParams.startTime = event->GetStartTime ();
+          rxParams.endTime = Simulator::Now ();
+
+          m_rxOkCallback (packet, rxParams);
         }
 
     }
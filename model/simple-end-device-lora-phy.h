@@ -50,7 +50,8 @@ public:
 
   // Implementation of EndDeviceLoraPhy's pure virtual functions
   virtual void StartReceive (Ptr<Packet> packet, double rxPowerDbm,
-                             uint8_t sf, Time duration, double frequencyMHz);
+                             uint8_t sf, Time duration, double frequencyMHz,
+                             double bandwidthHz);
 
   // Implementation of LoraPhy's pure virtual functions
   virtual void EndReceive (Ptr<Packet> packet,
@@ -21,7 +21,6 @@
 #include "ns3/simple-gateway-lora-phy.h"
 #include "ns3/log-macros-enabled.h"
 #include "ns3/lora-interference-helper.h"
-#include "ns3/lora-tag.h"
 #include "ns3/simulator.h"
 #include "ns3/log.h"
 
@@ -70,34 +69,30 @@ SimpleGatewayLoraPhy::Send (Ptr<Packet> packet, LoraTxParameters txParams,
                 unsigned(txParams.sf));
 
   // Interrupt all receive operations
-  std::list<Ptr<SimpleGatewayLoraPhy::ReceptionPath> >::iterator it;
-  for (it = m_receptionPaths.begin (); it != m_receptionPaths.end (); ++it)
+  for (uint64_t locked = m_lockedPaths; locked != 0; locked &= locked - 1)
     {
+      uint32_t path = __builtin_ctzll (locked);
+      ReceptionPath &currentPath = m_receptionPaths[path];
 
-      Ptr<SimpleGatewayLoraPhy::ReceptionPath> currentPath = *it;
-
-      if (!currentPath->IsAvailable ())     // Reception path is occupied
+      // Call the callback for reception interrupted by transmission
+      // Fire the trace source
+      if (m_device)
         {
-          // Call the callback for reception interrupted by transmission
-          // Fire the trace source
-          if (m_device)
-            {
-              m_noReceptionBecauseTransmitting (currentPath->GetEvent ()->GetPacket (),
-                                                m_device->GetNode ()->GetId ());
+          m_noReceptionBecauseTransmitting (currentPath.GetEvent ()->GetPacket (),
+                                            m_device->GetNode ()->GetId ());
 
-            }
-          else
-            {
-              m_noReceptionBecauseTransmitting (currentPath->GetEvent ()->GetPacket (), 0);
-            }
+        }
+      else
+        {
+          m_noReceptionBecauseTransmitting (currentPath.GetEvent ()->GetPacket (), 0);
+        }
 
-          // Cancel the scheduled EndReceive call
-          Simulator::Cancel (currentPath->GetEndReceive ());
+      // Cancel the scheduled EndReceive call
+      Simulator::Cancel (currentPath.GetEndReceive ());
 
-          // Free it
-          // This also resets all parameters like packet and endReceive call
-          currentPath->Free ();
-        }
+      // Free it
+      // This also resets all parameters like packet and endReceive call
+      FreePath (path);
     }
 
   // Send the packet in the channel
@@ -120,9 +115,10 @@ SimpleGatewayLoraPhy::Send (Ptr<Packet> packet, LoraTxParameters txParams,
 
 void
 SimpleGatewayLoraPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
-                                    uint8_t sf, Time duration, double frequencyMHz)
+                                    uint8_t sf, Time duration, double frequencyMHz,
+                                    double bandwidthHz)
 {
-  NS_LOG_FUNCTION (this << packet << rxPowerDbm << duration << frequencyMHz);
+  NS_LOG_FUNCTION (this << packet << rxPowerDbm << duration << frequencyMHz << bandwidthHz);
 
   // Fire the trace source
   m_phyRxBeginTrace (packet);
@@ -152,66 +148,60 @@ SimpleGatewayLoraPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
   // Add the event to the LoraInterferenceHelper
   Ptr<LoraInterferenceHelper::Event> event;
   event = m_interference.Add (duration, rxPowerDbm, sf, packet, frequencyMHz);
+  event->SetBandwidth (bandwidthHz);
 
-  // Cycle over the receive paths to check availability to receive the packet
-  std::list<Ptr<SimpleGatewayLoraPhy::ReceptionPath> >::iterator it;
+  // Find the first available receive path listening on the channel of
+  // interest
+  uint32_t path = GetAvailablePath (frequencyMHz);
 
-  for (it = m_receptionPaths.begin (); it != m_receptionPaths.end (); ++it)
+  if (path != NO_PATH)
     {
-      Ptr<SimpleGatewayLoraPhy::ReceptionPath> currentPath = *it;
+      NS_LOG_DEBUG ("ReceptionPath " << path << " is centered on frequency = " <<
+                    m_receptionPaths[path].GetFrequency ());
 
-      NS_LOG_DEBUG ("Current ReceptionPath is centered on frequency = " <<
-                    currentPath->GetFrequency ());
+      // See whether the reception power is above or below the sensitivity
+      // for that spreading factor
+      double sensitivity = SimpleGatewayLoraPhy::sensitivity[unsigned(sf) - 7];
 
-      // If the receive path is available and listening on the channel of
-      // interest, we have a candidate
-      if (currentPath->GetFrequency () == frequencyMHz
-          && currentPath->IsAvailable ())
+      if (rxPowerDbm < sensitivity)       // Packet arrived below sensitivity
         {
-          // See whether the reception power is above or below the sensitivity
-          // for that spreading factor
-          double sensitivity = SimpleGatewayLoraPhy::sensitivity[unsigned(sf) - 7];
+          NS_LOG_INFO ("Dropping packet reception of packet with sf = "
+                       << unsigned(sf) <<
+                       " because under the sensitivity of "
+                       << sensitivity << " dBm");
 
-          if (rxPowerDbm < sensitivity)       // Packet arrived below sensitivity
+          if (m_device)
             {
-              NS_LOG_INFO ("Dropping packet reception of packet with sf = "
-                           << unsigned(sf) <<
-                           " because under the sensitivity of "
-                           << sensitivity << " dBm");
-
-              if (m_device)
-                {
-                  m_underSensitivity (packet, m_device->GetNode ()->GetId ());
-                }
-              else
-                {
-                  m_underSensitivity (packet, 0);
-                }
-
-              // Since the packet is below sensitivity, it makes no sense to
-              // search for another ReceivePath
-              return;
+              m_underSensitivity (packet, m_device->GetNode ()->GetId ());
             }
-          else        // We have sufficient sensitivity to start receiving
+          else
             {
-              NS_LOG_INFO ("Scheduling reception of a packet, " <<
-                           "occupying one demodulator");
+              m_underSensitivity (packet, 0);
+            }
 
-              // Block this resource
-              currentPath->LockOnEvent (event);
-              m_occupiedReceptionPaths++;
+          // Since the packet is below sensitivity, it makes no sense to
+          // search for another ReceivePath
+          return;
+        }
+      else        // We have sufficient sensitivity to start receiving
+        {
+          NS_LOG_INFO ("Scheduling reception of a packet, " <<
+                       "occupying one demodulator");
 
-              // Schedule the end of the reception of the packet
-              EventId endReceiveEventId = Simulator::Schedule (duration,
-                                                               &LoraPhy::EndReceive,
-                                                               this, packet,
-                                                               event);
+          // Block this resource
+          LockPath (path, event);
+          m_occupiedReceptionPaths++;
 
-              currentPath->SetEndReceive (endReceiveEventId);
+          // Schedule the end of the reception of the packet
+          EventId endReceiveEventId = Simulator::Schedule (duration,
+                                                           &SimpleGatewayLoraPhy::EndReceiveOnPath,
+                                                           this, packet,
+                                                           event, path);
 
-              // Make sure we don't go on searching for other ReceivePaths
-              return;
-            }
+          m_receptionPaths[path].SetEndReceive (endReceiveEventId);
+
+          // Make sure we don't go on searching for other ReceivePaths
+          return;
         }
     }
   // If we get to this point, there are no demodulators we can use
@@ -236,6 +226,27 @@ SimpleGatewayLoraPhy::EndReceive (Ptr<Packet> packet,
 {
   NS_LOG_FUNCTION (this << packet << *event);
 
+  // Search for the demodulator that was locked on this event
+  uint32_t path = NO_PATH;
+  for (uint64_t locked = m_lockedPaths; locked != 0; locked &= locked - 1)
+    {
+      if (m_receptionPaths[__builtin_ctzll (locked)].GetEvent () == event)
+        {
+          path = __builtin_ctzll (locked);
+          break;
+        }
+    }
+
+  EndReceiveOnPath (packet, event, path);
+}
+
+void
+SimpleGatewayLoraPhy::EndReceiveOnPath (Ptr<Packet> packet,
+                                        Ptr<LoraInterferenceHelper::Event> event,
+                                        uint32_t path)
+{
+  NS_LOG_FUNCTION (this << packet << *event << path);
+
   // Call the trace source
   m_phyRxEndTrace (packet);
 
@@ -250,12 +261,6 @@ SimpleGatewayLoraPhy::EndReceive (Ptr<Packet> packet,
     {
       NS_LOG_DEBUG ("packetDestroyed by " << unsigned(packetDestroyed));
 
-      // Update the packet's LoraTag
-      LoraTag tag;
-      packet->RemovePacketTag (tag);
-      tag.SetDestroyedBy (packetDestroyed);
-      packet->AddPacketTag (tag);
-
       // Fire the trace source
       if (m_device)
         {
@@ -285,37 +290,30 @@ SimpleGatewayLoraPhy::EndReceive (Ptr<Packet> packet,
       // Forward the packet to the upper layer
       if (!m_rxOkCallback.IsNull ())
         {
-          // Make a copy of the packet
-          // Ptr<Packet> packetCopy = packet->Copy ();
-
-          // Set the receive power and frequency of this packet in the LoraTag: this
-          // information can be useful for upper layers trying to control link
-          // quality.
-          LoraTag tag;
-          packet->RemovePacketTag (tag);
-          tag.SetReceivePower (event->GetRxPowerdBm ());
-          tag.SetFrequency (event->GetFrequency ());
-          packet->AddPacketTag (tag);
-
-          m_rxOkCallback (packet);
+          // Describe this reception: the packet is shared with the other
+          // receivers on the channel, so its tags are left untouched.
+          LoraRxParameters rxParams;
+          rxParams.rxPowerDbm = event->GetRxPowerdBm ();
+          rxParams.snrDb = GetSnr (rxParams.rxPowerDbm, event->GetBandwidth ());
+          rxParams.sf = event->GetSpreadingFactor ();
+          rxParams.frequencyMHz = event->GetFrequency ();
+          rxParams.gatewayId = m_device ? m_device->GetNode ()->GetId () : 0;
+          rxParams.startTime = event->GetStartTime ();
+          rxParams.endTime = Simulator::Now ();
+
+          m_rxOkCallback (packet, rxParams);
         }
 
     }
 
-  // Search for the demodulator that was locked on this event to free it.
-
-  std::list< Ptr< SimpleGatewayLoraPhy::ReceptionPath > >::iterator it;
-
-  for (it = m_receptionPaths.begin (); it != m_receptionPaths.end (); ++it)
+  // Free the demodulator that was locked on this event, unless it was
+  // already freed while the packet was forwarded
+  if (path != NO_PATH && path < m_receptionPaths.size () &&
+      !m_receptionPaths[path].IsAvailable () &&
+      m_receptionPaths[path].GetEvent () == event)
     {
-      Ptr<SimpleGatewayLoraPhy::ReceptionPath> currentPath = *it;
-
-      if (currentPath->GetEvent () == event)
-        {
-          currentPath->Free ();
-          m_occupiedReceptionPaths--;
-          return;
-        }
+      FreePath (path);
+      m_occupiedReceptionPaths--;
     }
 }
 
@@ -329,20 +327,17 @@ SimpleGatewayLoraPhy::InterruptRx (Ptr<Packet> packet, Time realDuration)
 {
   NS_LOG_FUNCTION (this << packet << realDuration);
 
-  // Extract previous event
-  Ptr<LoraInterferenceHelper::Event> event = m_interference.GetEvent(packet);
-
-  // Search for the demodulator that was locked on this event to free it.
-  std::list<Ptr<SimpleGatewayLoraPhy::ReceptionPath>>::iterator it;
-  for (it = m_receptionPaths.begin (); it != m_receptionPaths.end (); ++it)
+  // Search for the demodulator that was locked on this packet to free it.
+  for (uint64_t locked = m_lockedPaths; locked != 0; locked &= locked - 1)
     {
-      Ptr<SimpleGatewayLoraPhy::ReceptionPath> currentPath = *it;
-      if (currentPath->GetEvent () == event)
+      uint32_t path = __builtin_ctzll (locked);
+      ReceptionPath &currentPath = m_receptionPaths[path];
+      if (currentPath.GetEvent ()->GetPacket () == packet)
         {
           NS_LOG_DEBUG("Found path locked on this packet");
           // Cancel the reception of the packet and free the path
-          Simulator::Cancel (currentPath->GetEndReceive ());
-          currentPath->Free ();
+          Simulator::Cancel (currentPath.GetEndReceive ());
+          FreePath (path);
           m_occupiedReceptionPaths--;
         }
     }
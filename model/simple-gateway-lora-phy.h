@@ -28,7 +28,6 @@
 #include "ns3/node.h"
 #include "ns3/gateway-lora-phy.h"
 #include "ns3/traced-value.h"
-#include <list>
 
 namespace ns3 {
 namespace lorawan {
@@ -47,7 +46,7 @@ public:
   virtual ~SimpleGatewayLoraPhy ();
 
   virtual void StartReceive (Ptr<Packet> packet, double rxPowerDbm, uint8_t sf,
-                             Time duration, double frequencyMHz);
+                             Time duration, double frequencyMHz, double bandwidthHz);
 
   virtual void EndReceive (Ptr<Packet> packet,
                            Ptr<LoraInterferenceHelper::Event> event);
@@ -58,6 +57,16 @@ public:
   virtual void InterruptTx (void) override;
   virtual void InterruptRx (Ptr<Packet> packet, Time realTime) override;
 private:
+  /**
+   * Finish the reception of a packet on a reception path, and free the path.
+   *
+   * \param packet The packet being received.
+   * \param event The LoraInterferenceHelper Event of the packet.
+   * \param path The index of the path locked on the event, or NO_PATH.
+   */
+  void EndReceiveOnPath (Ptr<Packet> packet,
+                         Ptr<LoraInterferenceHelper::Event> event,
+                         uint32_t path);
 };
 
 } /* namespace ns3 */
@@ -5,18 +5,43 @@
 #include "ns3/lora-helper.h"
 #include "ns3/simple-end-device-lora-phy.h"
 #include "ns3/simple-gateway-lora-phy.h"
+#include "ns3/lora-tag.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/one-shot-sender-helper.h"
 #include "ns3/constant-position-mobility-model.h"
+#include "ns3/building-penetration-loss.h"
+#include "ns3/buildings-helper.h"
+#include "ns3/building.h"
+#include "ns3/mobility-building-info.h"
+#include "ns3/correlated-shadowing-propagation-loss-model.h"
+#include "ns3/raster-propagation-loss-model.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
+#include <cmath>
+#include <cstdio>
+#include <limits>
 
 using namespace ns3;
 using namespace lorawan;
 
 NS_LOG_COMPONENT_DEFINE ("LorawanTestSuite");
 
+/**
+ * Create a static mobility model at the given position, which building
+ * aware propagation models can locate.
+ */
+static Ptr<MobilityModel>
+CreateMobility (Vector position)
+{
+  Ptr<ConstantPositionMobilityModel> mobility =
+    CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (position);
+  mobility->AggregateObject (CreateObject<MobilityBuildingInfo> ());
+  BuildingsHelper::MakeConsistent (mobility);
+  return mobility;
+}
+
 /********************
  * InterferenceTest *
  ********************/
@@ -151,6 +176,37 @@ InterferenceTest::DoRun (void)
   interferenceHelper.Add (Seconds (2), 14 + 16, 10, 0, frequency);
   NS_TEST_EXPECT_MSG_EQ (interferenceHelper.IsDestroyedByInterference (event), 0, "Packet did not survive interference as expected");
   interferenceHelper.ClearAllEvents ();
+
+  // Pruning
+  // Signals below the pruning floor are not considered as interferers
+  interferenceHelper.SetPruningFloor (-140);
+  event = interferenceHelper.Add (Seconds (2), -145, 7, 0, frequency);
+  interferenceHelper.Add (Seconds (2), -145, 7, 0, frequency);
+  NS_TEST_EXPECT_MSG_EQ (interferenceHelper.IsDestroyedByInterference (event), 0, "Packet was destroyed by a pruned interferer");
+  interferenceHelper.SetPruningFloor (-std::numeric_limits<double>::infinity ());
+  interferenceHelper.ClearAllEvents ();
+
+  // Shared ledger
+  // Interferers are taken from the ledger, with the power they have at each
+  // receiver
+  LoraInterferenceHelper ledger;
+  LoraInterferenceHelper otherHelper;
+  interferenceHelper.SetLedger (&ledger, ledger.AddReceiver ());
+  otherHelper.SetLedger (&ledger, ledger.AddReceiver ());
+  Ptr<Packet> packet = Create<Packet> (10);
+  Ptr<Packet> interferingPacket = Create<Packet> (10);
+  Ptr<LoraInterferenceHelper::Event> transmission =
+    ledger.AddTransmission (Seconds (2), 7, packet, frequency);
+  transmission->SetRxPowerdBm (0, 14);
+  transmission->SetRxPowerdBm (1, 14);
+  transmission = ledger.AddTransmission (Seconds (2), 7, interferingPacket, frequency);
+  transmission->SetRxPowerdBm (0, 14);
+  transmission->SetRxPowerdBm (1, 14 - 7);
+  event = interferenceHelper.Add (Seconds (2), 14, 7, packet, frequency);
+  NS_TEST_EXPECT_MSG_EQ (interferenceHelper.IsDestroyedByInterference (event), 7, "Packet was not destroyed by interference as expected");
+  event = otherHelper.Add (Seconds (2), 14, 7, packet, frequency);
+  NS_TEST_EXPECT_MSG_EQ (otherHelper.IsDestroyedByInterference (event), 0, "Packet did not survive interference as expected");
+  interferenceHelper.SetLedger (0, 0);
 }
 
 /***************
@@ -465,7 +521,7 @@ ReceivePathTest::DoRun (void)
   //////////////////////////////////////////////////////////////////////////////////
 
   Simulator::Schedule (Seconds (1), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (1), frequency4);
+                       packet, 14, 7, Seconds (1), frequency4, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -480,17 +536,17 @@ ReceivePathTest::DoRun (void)
   //////////////////////////////////////////////////////////////////////////////
 
   Simulator::Schedule (Seconds (1), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (1), frequency1);
+                       packet, 14, 7, Seconds (1), frequency1, 125000.0);
   Simulator::Schedule (Seconds (3), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 8, Seconds (1), frequency1);
+                       packet, 14, 8, Seconds (1), frequency1, 125000.0);
   Simulator::Schedule (Seconds (5), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (1), frequency1);
+                       packet, 14, 9, Seconds (1), frequency1, 125000.0);
   Simulator::Schedule (Seconds (7), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (1), frequency1);
+                       packet, 14, 10, Seconds (1), frequency1, 125000.0);
   Simulator::Schedule (Seconds (9), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 11, Seconds (1), frequency1);
+                       packet, 14, 11, Seconds (1), frequency1, 125000.0);
   Simulator::Schedule (Seconds (11), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 12, Seconds (1), frequency1);
+                       packet, 14, 12, Seconds (1), frequency1, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -506,9 +562,9 @@ ReceivePathTest::DoRun (void)
   // reception paths listening. Each packet should be received correctly.
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (3), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (4), frequency1);
+                       packet, 14, 9, Seconds (4), frequency1, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -523,9 +579,9 @@ ReceivePathTest::DoRun (void)
   // Interference between packets on the same frequency and different ReceptionPaths
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (3), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -540,11 +596,11 @@ ReceivePathTest::DoRun (void)
   // Three receptions where only two receivePaths are available
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (3), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -558,9 +614,9 @@ ReceivePathTest::DoRun (void)
   // Packets that are on different frequencys do not interfere
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency2);
+                       packet, 14, 7, Seconds (4), frequency2, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -574,17 +630,17 @@ ReceivePathTest::DoRun (void)
   // Full capacity
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 8, Seconds (4), frequency1);
+                       packet, 14, 8, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (4), frequency2);
+                       packet, 14, 9, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (4), frequency2);
+                       packet, 14, 10, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 11, Seconds (4), frequency3);
+                       packet, 14, 11, Seconds (4), frequency3, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 12, Seconds (4), frequency3);
+                       packet, 14, 12, Seconds (4), frequency3, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -600,19 +656,19 @@ ReceivePathTest::DoRun (void)
   // Full capacity + 1
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 8, Seconds (4), frequency1);
+                       packet, 14, 8, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (4), frequency2);
+                       packet, 14, 9, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (4), frequency2);
+                       packet, 14, 10, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 11, Seconds (4), frequency3);
+                       packet, 14, 11, Seconds (4), frequency3, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 12, Seconds (4), frequency3);
+                       packet, 14, 12, Seconds (4), frequency3, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (4), frequency3);
+                       packet, 14, 10, Seconds (4), frequency3, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -628,30 +684,30 @@ ReceivePathTest::DoRun (void)
   // Receive Paths are correctly freed
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 8, Seconds (4), frequency1);
+                       packet, 14, 8, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (4), frequency2);
+                       packet, 14, 9, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (4), frequency2);
+                       packet, 14, 10, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 11, Seconds (4), frequency3);
+                       packet, 14, 11, Seconds (4), frequency3, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 12, Seconds (4), frequency3);
+                       packet, 14, 12, Seconds (4), frequency3, 125000.0);
 
   Simulator::Schedule (Seconds (8), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (8), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 8, Seconds (4), frequency1);
+                       packet, 14, 8, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (8), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (4), frequency2);
+                       packet, 14, 9, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (8), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (4), frequency2);
+                       packet, 14, 10, Seconds (4), frequency2, 125000.0);
   Simulator::Schedule (Seconds (8), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 11, Seconds (4), frequency3);
+                       packet, 14, 11, Seconds (4), frequency3, 125000.0);
   Simulator::Schedule (Seconds (8), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 12, Seconds (4), frequency3);
+                       packet, 14, 12, Seconds (4), frequency3, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -668,17 +724,17 @@ ReceivePathTest::DoRun (void)
   // Occupy both ReceptionPaths centered at frequency1
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 8, Seconds (4), frequency1);
+                       packet, 14, 8, Seconds (4), frequency1, 125000.0);
 
   // This packet will find no free ReceptionPaths
   Simulator::Schedule (Seconds (2 + 4) - NanoSeconds (1), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 9, Seconds (4), frequency1);
+                       packet, 14, 9, Seconds (4), frequency1, 125000.0);
 
   // This packet will find a free ReceptionPath
   Simulator::Schedule (Seconds (2 + 4) + NanoSeconds (1), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 10, Seconds (4), frequency1);
+                       packet, 14, 10, Seconds (4), frequency1, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -694,7 +750,7 @@ ReceivePathTest::DoRun (void)
   // Only one ReceivePath locks on the incoming packet
   ///////////////////////////////////////////////////////////////////////////
   Simulator::Schedule (Seconds (2), &SimpleGatewayLoraPhy::StartReceive, gatewayPhy,
-                       packet, 14, 7, Seconds (4), frequency1);
+                       packet, 14, 7, Seconds (4), frequency1, 125000.0);
 
   Simulator::Stop (Hours (2));
   Simulator::Run ();
@@ -921,6 +977,23 @@ TimeOnAirTest::DoRun (void)
   txParams.codingRate = 1;
   duration = LoraPhy::GetOnAirTime (packet, txParams);
   NS_TEST_EXPECT_MSG_EQ_TOL (duration.GetSeconds (), 2.301952, 0.0001, "Unexpected duration");
+
+  // Tabulated values are the same when they are read again
+  duration = LoraPhy::GetOnAirTime (packet, txParams);
+  NS_TEST_EXPECT_MSG_EQ_TOL (duration.GetSeconds (), 2.301952, 0.0001, "Unexpected duration");
+
+  // Compile time parameters give the same durations
+  duration = LoraPhy::GetOnAirTime<12, 125000> (packet, txParams);
+  NS_TEST_EXPECT_MSG_EQ (duration, LoraPhy::GetOnAirTime (packet, txParams), "Unexpected duration");
+
+  txParams.sf = 7;
+  duration = LoraPhy::GetOnAirTime<7, 125000> (packet, txParams);
+  NS_TEST_EXPECT_MSG_EQ (duration, LoraPhy::GetOnAirTime (packet, txParams), "Unexpected duration");
+
+  // Payloads that are too long to be tabulated are computed directly
+  packet = Create<Packet> (300);
+  duration = LoraPhy::GetOnAirTime<7, 125000> (packet, txParams);
+  NS_TEST_EXPECT_MSG_EQ_TOL (duration.GetSeconds (), 0.466176, 0.0001, "Unexpected duration");
 }
 
 /**************************
@@ -1289,6 +1362,172 @@ PhyConnectivityTest::DoRun (void)
 
   NS_TEST_EXPECT_MSG_EQ (edPhy1->GetState (), SimpleEndDeviceLoraPhy::STANDBY, "State didn't switch to STANDBY as expected");
   NS_TEST_EXPECT_MSG_EQ (edPhy2->GetState (), SimpleEndDeviceLoraPhy::STANDBY, "State didn't switch to STANDBY as expected");
+
+  Reset ();
+
+  // Batch computation of the received power
+  //////////////////////////////////////////
+
+  // The batch gives the same result as computing each link separately
+  std::vector<Ptr<MobilityModel> > receivers;
+  receivers.push_back (edPhy2->GetMobility ());
+  receivers.push_back (edPhy3->GetMobility ());
+  receivers.push_back (edPhy1->GetMobility ());
+  std::vector<double> rxPowers;
+  channel->GetRxPowers (14, edPhy1->GetMobility (), receivers, rxPowers);
+
+  NS_TEST_EXPECT_MSG_EQ (rxPowers.size (), receivers.size (), "Batch didn't compute one power per receiver");
+  for (uint32_t k = 0; k < receivers.size (); k++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (rxPowers[k],
+                             channel->GetRxPower (14, edPhy1->GetMobility (), receivers[k]),
+                             "Batch received power differs from the single link one");
+    }
+}
+
+/********************
+ * RxParametersTest *
+ ********************/
+
+class RxParametersTest : public TestCase
+{
+public:
+  RxParametersTest ();
+  virtual ~RxParametersTest ();
+
+private:
+  virtual void DoRun (void);
+  void ReceivedPacket (Ptr<const Packet> packet, const LoraRxParameters &rxParams);
+  Ptr<SimpleGatewayLoraPhy> CreateGateway (Ptr<LoraChannel> channel, Vector position);
+
+  std::vector<LoraRxParameters> m_rxParams;
+  std::vector<Ptr<const Packet> > m_rxPackets;
+};
+
+// Add some help text to this case to describe what it is intended to test
+RxParametersTest::RxParametersTest ()
+  : TestCase ("Verify that each reception of a packet is described by its own parameters")
+{
+}
+
+// Reminder that the test case should clean up after itself
+RxParametersTest::~RxParametersTest ()
+{
+}
+
+void
+RxParametersTest::ReceivedPacket (Ptr<const Packet> packet, const LoraRxParameters &rxParams)
+{
+  NS_LOG_FUNCTION (packet << rxParams);
+
+  m_rxPackets.push_back (packet);
+  m_rxParams.push_back (rxParams);
+}
+
+Ptr<SimpleGatewayLoraPhy>
+RxParametersTest::CreateGateway (Ptr<LoraChannel> channel, Vector position)
+{
+  // The gateway id comes from the node of the PHY's device
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<LoraNetDevice> device = CreateObject<LoraNetDevice> ();
+  node->AddDevice (device);
+
+  Ptr<SimpleGatewayLoraPhy> phy = CreateObject<SimpleGatewayLoraPhy> ();
+  phy->SetDevice (device);
+  phy->SetMobility (CreateMobility (position));
+  phy->AddReceptionPath (868.1);
+  phy->SetReceiveOkCallback (MakeCallback (&RxParametersTest::ReceivedPacket, this));
+
+  channel->Add (phy);
+  phy->SetChannel (channel);
+  return phy;
+}
+
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+void
+RxParametersTest::DoRun (void)
+{
+  NS_LOG_DEBUG ("RxParametersTest");
+
+  Ptr<LogDistancePropagationLossModel> loss =
+    CreateObject<LogDistancePropagationLossModel> ();
+  loss->SetPathLossExponent (3.76);
+  loss->SetReference (1, 7.7);
+  Ptr<PropagationDelayModel> delay =
+    CreateObject<ConstantSpeedPropagationDelayModel> ();
+  Ptr<LoraChannel> channel = CreateObject<LoraChannel> (loss, delay);
+
+  Ptr<SimpleEndDeviceLoraPhy> edPhy = CreateObject<SimpleEndDeviceLoraPhy> ();
+  edPhy->SetMobility (CreateMobility (Vector (0, 0, 0)));
+  edPhy->SetFrequency (868.1);
+  edPhy->SwitchToStandby ();
+  channel->Add (edPhy);
+  edPhy->SetChannel (channel);
+
+  Ptr<SimpleGatewayLoraPhy> nearGateway = CreateGateway (channel, Vector (100, 0, 0));
+  Ptr<SimpleGatewayLoraPhy> farGateway = CreateGateway (channel, Vector (1000, 0, 0));
+
+  // The sender's tag must reach every receiver as it was sent
+  uint8_t buffer[10] = {0,0,0,0,0,0,0,0,0,0};
+  Ptr<Packet> packet = Create<Packet> (buffer, 10);
+  LoraTag tag (12, 0);
+  packet->AddPacketTag (tag);
+
+  LoraTxParameters txParams;
+  txParams.sf = 12;
+
+  Simulator::Schedule (Seconds (2), &SimpleEndDeviceLoraPhy::Send, edPhy, packet,
+                       txParams, 868.1, 14);
+  Simulator::Stop (Hours (2));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_rxParams.size (), 2, "Packet wasn't received by both gateways");
+
+  uint32_t nearId = nearGateway->GetDevice ()->GetNode ()->GetId ();
+  uint32_t farId = farGateway->GetDevice ()->GetNode ()->GetId ();
+  NS_TEST_EXPECT_MSG_NE (m_rxParams[0].gatewayId, m_rxParams[1].gatewayId,
+                         "Both receptions report the same gateway");
+  NS_TEST_EXPECT_MSG_NE (m_rxParams[0].rxPowerDbm, m_rxParams[1].rxPowerDbm,
+                         "Both receptions report the same received power");
+
+  for (uint32_t i = 0; i < m_rxParams.size (); i++)
+    {
+      const LoraRxParameters &rxParams = m_rxParams[i];
+      Ptr<SimpleGatewayLoraPhy> gateway = rxParams.gatewayId == nearId ? nearGateway : farGateway;
+      NS_TEST_EXPECT_MSG_EQ ((rxParams.gatewayId == nearId || rxParams.gatewayId == farId), true,
+                             "Reception reports an unknown gateway");
+      NS_TEST_EXPECT_MSG_EQ_TOL (rxParams.rxPowerDbm,
+                                 channel->GetRxPower (14, edPhy->GetMobility (),
+                                                      gateway->GetMobility ()),
+                                 0.0001, "Reception reports the power of another link");
+      NS_TEST_EXPECT_MSG_EQ_TOL (rxParams.snrDb,
+                                 LoraPhy::GetSnr (rxParams.rxPowerDbm, 125000), 0.0001,
+                                 "SNR doesn't account for the 125 kHz bandwidth");
+      NS_TEST_EXPECT_MSG_EQ (unsigned (rxParams.sf), 12, "Wrong spreading factor");
+      NS_TEST_EXPECT_MSG_EQ_TOL (rxParams.frequencyMHz, 868.1, 0.0001, "Wrong frequency");
+    }
+
+  // A wider band collects more noise
+  NS_TEST_EXPECT_MSG_EQ_TOL (LoraPhy::GetSnr (-100, 250000),
+                             LoraPhy::GetSnr (-100, 125000) - 10 * std::log10 (2), 0.0001,
+                             "SNR doesn't depend on the bandwidth");
+
+  // Receivers get the shared packet, whose tag is left as the sender set it
+  LoraTag receivedTag;
+  for (uint32_t i = 0; i < m_rxPackets.size (); i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_rxPackets[i]->PeekPacketTag (receivedTag), true,
+                             "Sender's tag was removed");
+      NS_TEST_EXPECT_MSG_EQ (receivedTag.GetReceivePower (), 0.0,
+                             "Reception power was written in the shared tag");
+      NS_TEST_EXPECT_MSG_EQ (receivedTag.GetFrequency (), 0.0,
+                             "Reception frequency was written in the shared tag");
+    }
+  NS_TEST_EXPECT_MSG_EQ (packet->PeekPacketTag (receivedTag), true, "Sender's tag was removed");
+  NS_TEST_EXPECT_MSG_EQ (receivedTag.GetReceivePower (), 0.0,
+                         "Reception power was written in the sender's tag");
 }
 
 /*****************
@@ -1325,6 +1564,380 @@ LorawanMacTest::DoRun (void)
 
 }
 
+/*******************************
+ * BuildingPenetrationLossTest *
+ *******************************/
+
+class BuildingPenetrationLossTest : public TestCase
+{
+public:
+  BuildingPenetrationLossTest ();
+  virtual ~BuildingPenetrationLossTest ();
+
+private:
+  virtual void DoRun (void);
+};
+
+// Add some help text to this case to describe what it is intended to test
+BuildingPenetrationLossTest::BuildingPenetrationLossTest ()
+  : TestCase ("Verify that BuildingPenetrationLoss only attenuates indoor links")
+{
+}
+
+// Reminder that the test case should clean up after itself
+BuildingPenetrationLossTest::~BuildingPenetrationLossTest ()
+{
+}
+
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+void
+BuildingPenetrationLossTest::DoRun (void)
+{
+  NS_LOG_DEBUG ("BuildingPenetrationLossTest");
+
+  Ptr<Building> building = CreateObject<Building> ();
+  building->SetBoundaries (Box (0, 100, 0, 100, 0, 10));
+
+  Ptr<MobilityModel> indoor = CreateMobility (Vector (50, 50, 1.2));
+  Ptr<MobilityModel> outdoor = CreateMobility (Vector (500, 50, 1.2));
+  Ptr<MobilityModel> otherOutdoor = CreateMobility (Vector (1000, 50, 1.2));
+
+  Ptr<BuildingPenetrationLoss> loss = CreateObject<BuildingPenetrationLoss> ();
+  NS_TEST_ASSERT_MSG_EQ (loss->IsFixedPerLink (), false,
+                         "The fixed per-link mode should be off by default");
+
+  // Two outdoor devices: no penetration loss
+  NS_TEST_EXPECT_MSG_EQ_TOL (loss->CalcRxPower (14, outdoor, otherOutdoor), 14,
+                             0.0001, "Outdoor link was attenuated");
+
+  // An indoor device: at least the smallest external wall loss (4 dB)
+  NS_TEST_EXPECT_MSG_LT (loss->CalcRxPower (14, outdoor, indoor), 10,
+                         "Outdoor to indoor link was not attenuated enough");
+  NS_TEST_EXPECT_MSG_LT (loss->CalcRxPower (14, indoor, outdoor), 10,
+                         "Indoor to outdoor link was not attenuated enough");
+
+  // With the loss fixed per link, the chain can be cached by the channel
+  Ptr<LogDistancePropagationLossModel> chain = CreateObject<LogDistancePropagationLossModel> ();
+  chain->SetNext (loss);
+  NS_TEST_EXPECT_MSG_EQ (LoraChannel::IsDeterministic (chain), false,
+                         "A chain with random building losses was deemed deterministic");
+  loss->SetFixedPerLink (true);
+  NS_TEST_EXPECT_MSG_EQ (LoraChannel::IsDeterministic (chain), true,
+                         "A chain with fixed building losses was not deemed deterministic");
+
+  // Repeated evaluations of a link give the same loss
+  double fixed = loss->CalcRxPower (14, outdoor, indoor);
+  NS_TEST_EXPECT_MSG_LT (fixed, 10, "Fixed indoor link was not attenuated enough");
+  for (int i = 0; i < 5; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (loss->CalcRxPower (14, outdoor, indoor), fixed,
+                             "The loss of a fixed link changed");
+    }
+
+  // Other links, including the reverse one, are drawn separately
+  Ptr<MobilityModel> otherIndoor = CreateMobility (Vector (60, 50, 1.2));
+  NS_TEST_EXPECT_MSG_NE (loss->CalcRxPower (14, outdoor, otherIndoor), fixed,
+                         "Two links were given the same loss");
+  NS_TEST_EXPECT_MSG_NE (loss->CalcRxPower (14, indoor, outdoor), fixed,
+                         "The reverse link was given the same loss");
+  NS_TEST_EXPECT_MSG_EQ_TOL (loss->CalcRxPower (14, outdoor, otherOutdoor), 14, 0.0001,
+                             "Fixed outdoor link was attenuated");
+}
+
+/*********************
+ * PacketTrackerTest *
+ *********************/
+
+class PacketTrackerTest : public TestCase
+{
+public:
+  PacketTrackerTest ();
+  virtual ~PacketTrackerTest ();
+
+  Ptr<Packet> CreateUplinkPacket (void);
+
+private:
+  virtual void DoRun (void);
+};
+
+// Add some help text to this case to describe what it is intended to test
+PacketTrackerTest::PacketTrackerTest ()
+  : TestCase ("Verify that LoraPacketTracker counts packets correctly")
+{
+}
+
+// Reminder that the test case should clean up after itself
+PacketTrackerTest::~PacketTrackerTest ()
+{
+}
+
+Ptr<Packet>
+PacketTrackerTest::CreateUplinkPacket (void)
+{
+  Ptr<Packet> packet = Create<Packet> (10);
+  LorawanMacHeader macHdr;
+  macHdr.SetMType (LorawanMacHeader::UNCONFIRMED_DATA_UP);
+  packet->AddHeader (macHdr);
+  return packet;
+}
+
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+void
+PacketTrackerTest::DoRun (void)
+{
+  NS_LOG_DEBUG ("PacketTrackerTest");
+
+  // Use buckets that are smaller than the longest windows below, so that
+  // counts come both from buckets and from rows
+  LoraPacketTracker tracker;
+  tracker.SetBucketWidth (Seconds (1));
+
+  Ptr<Packet> first = CreateUplinkPacket ();
+  Ptr<Packet> second = CreateUplinkPacket ();
+  Ptr<Packet> third = CreateUplinkPacket ();
+
+  // Device 0 sends three packets, the last one is interrupted
+  Simulator::Schedule (Seconds (1), &LoraPacketTracker::TransmissionCallback,
+                       &tracker, first, 0);
+  Simulator::Schedule (Seconds (2), &LoraPacketTracker::TransmissionCallback,
+                       &tracker, second, 0);
+  Simulator::Schedule (Seconds (3), &LoraPacketTracker::TransmissionCallback,
+                       &tracker, third, 0);
+  Simulator::Schedule (Seconds (3.1), &LoraPacketTracker::InterruptedTransmissionCallback,
+                       &tracker, third);
+
+  // Outcomes at gateways 10 and 11. The second outcome of the first packet at
+  // gateway 10 is ignored.
+  Simulator::Schedule (Seconds (1.5), &LoraPacketTracker::PacketReceptionCallback,
+                       &tracker, first, 10);
+  Simulator::Schedule (Seconds (1.5), &LoraPacketTracker::InterferenceCallback,
+                       &tracker, first, 10);
+  Simulator::Schedule (Seconds (1.5), &LoraPacketTracker::UnderSensitivityCallback,
+                       &tracker, first, 11);
+  Simulator::Schedule (Seconds (2.5), &LoraPacketTracker::InterferenceCallback,
+                       &tracker, second, 10);
+
+  // MAC layer: only the first packet reaches a gateway
+  Simulator::Schedule (Seconds (1), &LoraPacketTracker::MacTransmissionCallback,
+                       &tracker, first);
+  Simulator::Schedule (Seconds (2), &LoraPacketTracker::MacTransmissionCallback,
+                       &tracker, second);
+  Simulator::Schedule (Seconds (1.5), &LoraPacketTracker::MacGwReceptionCallback,
+                       &tracker, first);
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  std::vector<int> counts = tracker.CountPhyPacketsPerGw (Seconds (0), Seconds (10), 10);
+  NS_TEST_EXPECT_MSG_EQ (counts.at (0), 2, "Wrong number of sent packets");
+  NS_TEST_EXPECT_MSG_EQ (counts.at (1), 1, "Wrong number of received packets");
+  NS_TEST_EXPECT_MSG_EQ (counts.at (2), 1, "Wrong number of interfered packets");
+
+  counts = tracker.CountPhyPacketsPerGw (Seconds (1), Seconds (3), 10);
+  NS_TEST_EXPECT_MSG_EQ (counts.at (0), 2, "Interrupted packet was counted");
+  NS_TEST_EXPECT_MSG_EQ (counts.at (1), 1, "Wrong number of received packets in window");
+  NS_TEST_EXPECT_MSG_EQ (counts.at (2), 1, "Wrong number of interfered packets in window");
+
+  counts = tracker.CountPhyPacketsPerGw (Seconds (1.5), Seconds (2), 11);
+  NS_TEST_EXPECT_MSG_EQ (counts.at (0), 1, "Wrong number of sent packets in window");
+  NS_TEST_EXPECT_MSG_EQ (counts.at (4), 0, "Packet outside window was counted");
+
+  counts = tracker.CountPhyPacketsPerGw (Seconds (1), Seconds (1), 11);
+  NS_TEST_EXPECT_MSG_EQ (counts.at (4), 1, "Wrong number of packets under sensitivity");
+
+  counts = tracker.CountPhyPacketsPerEd (Seconds (0), Seconds (10), 0);
+  NS_TEST_EXPECT_MSG_EQ (counts.at (0), 3, "Wrong number of packets sent by the device");
+  NS_TEST_EXPECT_MSG_EQ (counts.at (2), 1, "Wrong number of interrupted packets");
+
+  NS_TEST_EXPECT_MSG_EQ (tracker.CountMacPacketsGlobally (Seconds (0), Seconds (10)),
+                         std::to_string (2.0) + " " + std::to_string (1.0),
+                         "Wrong MAC packet counts");
+}
+
+/********************************
+ * CorrelatedShadowingFieldTest *
+ ********************************/
+
+class CorrelatedShadowingFieldTest : public TestCase
+{
+public:
+  CorrelatedShadowingFieldTest ();
+  virtual ~CorrelatedShadowingFieldTest ();
+
+private:
+  virtual void DoRun (void);
+};
+
+// Add some help text to this case to describe what it is intended to test
+CorrelatedShadowingFieldTest::CorrelatedShadowingFieldTest ()
+  : TestCase ("Verify that an exported shadowing field gives the same losses once loaded")
+{
+}
+
+// Reminder that the test case should clean up after itself
+CorrelatedShadowingFieldTest::~CorrelatedShadowingFieldTest ()
+{
+}
+
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+void
+CorrelatedShadowingFieldTest::DoRun (void)
+{
+  NS_LOG_DEBUG ("CorrelatedShadowingFieldTest");
+
+  // Senders and receivers spread over several squares of the grid
+  std::vector<Ptr<MobilityModel> > senders;
+  std::vector<Ptr<MobilityModel> > receivers;
+  Vector senderPositions[] = {Vector (0, 0, 0), Vector (300, -40, 0)};
+  Vector receiverPositions[] = {Vector (10, 20, 0), Vector (150, -30, 0),
+                                Vector (500, 400, 0), Vector (-260, 75, 0)};
+  for (const Vector &position : senderPositions)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility =
+        CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (position);
+      senders.push_back (mobility);
+    }
+  for (const Vector &position : receiverPositions)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility =
+        CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (position);
+      receivers.push_back (mobility);
+    }
+
+  Ptr<CorrelatedShadowingPropagationLossModel> model =
+    CreateObject<CorrelatedShadowingPropagationLossModel> ();
+  model->AssignStreams (10);
+  std::vector<double> rxPowers;
+  for (const Ptr<MobilityModel> &sender : senders)
+    {
+      for (const Ptr<MobilityModel> &receiver : receivers)
+        {
+          rxPowers.push_back (model->CalcRxPower (14, sender, receiver));
+        }
+    }
+
+  std::string filename = CreateTempDirFilename ("shadowing-field.bin");
+  NS_TEST_ASSERT_MSG_EQ (model->ExportField (filename), true,
+                         "The shadowing field could not be exported");
+
+  // A fresh model with the same stream uses the field
+  Ptr<CorrelatedShadowingPropagationLossModel> loaded =
+    CreateObject<CorrelatedShadowingPropagationLossModel> ();
+  loaded->AssignStreams (10);
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadField (filename), true,
+                         "The shadowing field could not be loaded");
+  std::size_t i = 0;
+  for (const Ptr<MobilityModel> &sender : senders)
+    {
+      for (const Ptr<MobilityModel> &receiver : receivers)
+        {
+          NS_TEST_EXPECT_MSG_EQ (loaded->CalcRxPower (14, sender, receiver), rxPowers[i++],
+                                 "The loaded field gave a different loss");
+        }
+    }
+
+  // A model with a different stream would generate a different field
+  Ptr<CorrelatedShadowingPropagationLossModel> otherStream =
+    CreateObject<CorrelatedShadowingPropagationLossModel> ();
+  otherStream->AssignStreams (11);
+  NS_TEST_EXPECT_MSG_EQ (otherStream->LoadField (filename), false,
+                         "A field generated with another stream was loaded");
+
+  std::remove (filename.c_str ());
+}
+
+/*****************************
+ * RasterPropagationLossTest *
+ *****************************/
+
+class RasterPropagationLossTest : public TestCase
+{
+public:
+  RasterPropagationLossTest ();
+  virtual ~RasterPropagationLossTest ();
+
+private:
+  virtual void DoRun (void);
+};
+
+// Add some help text to this case to describe what it is intended to test
+RasterPropagationLossTest::RasterPropagationLossTest ()
+  : TestCase ("Verify that RasterPropagationLossModel interpolates the wrapped chain")
+{
+}
+
+// Reminder that the test case should clean up after itself
+RasterPropagationLossTest::~RasterPropagationLossTest ()
+{
+}
+
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+void
+RasterPropagationLossTest::DoRun (void)
+{
+  NS_LOG_DEBUG ("RasterPropagationLossTest");
+
+  Ptr<LogDistancePropagationLossModel> chain = CreateObject<LogDistancePropagationLossModel> ();
+  chain->SetPathLossExponent (3.76);
+  chain->SetReference (1, 7.7);
+
+  Ptr<RasterPropagationLossModel> raster = CreateObject<RasterPropagationLossModel> ();
+  raster->SetModel (chain);
+  raster->SetAttribute ("Area", BoxValue (Box (0, 100, 0, 100, 0, 0)));
+  raster->SetAttribute ("Resolution", DoubleValue (10));
+  raster->SetAttribute ("Height", DoubleValue (1.2));
+
+  // A gateway outside of the area, so that the gain is smooth inside it
+  Ptr<MobilityModel> gateway = CreateMobility (Vector (-500, 50, 15));
+  raster->AddStaticNode (gateway);
+
+  // At raster points, the chain is evaluated exactly, in both directions
+  Ptr<MobilityModel> onPoint = CreateMobility (Vector (20, 30, 1.2));
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, onPoint, gateway),
+                             chain->CalcRxPower (14, onPoint, gateway), 1e-9,
+                             "Wrong uplink gain at a raster point");
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, gateway, onPoint),
+                             chain->CalcRxPower (14, gateway, onPoint), 1e-9,
+                             "Wrong downlink gain at a raster point");
+
+  // The height of the end device is ignored
+  Ptr<MobilityModel> high = CreateMobility (Vector (20, 30, 50));
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, high, gateway),
+                             chain->CalcRxPower (14, onPoint, gateway), 1e-9,
+                             "The height of the end device was not ignored");
+
+  // In the middle of a cell, the gain is the average of the 4 corners, which
+  // is close to the chain since the gain is smooth
+  Ptr<MobilityModel> midCell = CreateMobility (Vector (25, 35, 1.2));
+  double corners = 0;
+  Vector cornerPositions[] = {Vector (20, 30, 1.2), Vector (30, 30, 1.2),
+                              Vector (20, 40, 1.2), Vector (30, 40, 1.2)};
+  for (const Vector &position : cornerPositions)
+    {
+      corners += chain->CalcRxPower (14, CreateMobility (position), gateway) / 4;
+    }
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, midCell, gateway), corners, 1e-9,
+                             "Wrong interpolation in the middle of a cell");
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, midCell, gateway),
+                             chain->CalcRxPower (14, midCell, gateway), 0.01,
+                             "Interpolated gain is far from the chain");
+
+  // Outside of the area, the chain is used
+  Ptr<MobilityModel> outside = CreateMobility (Vector (200, 50, 1.2));
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, outside, gateway),
+                             chain->CalcRxPower (14, outside, gateway), 1e-9,
+                             "Wrong uplink gain outside of the area");
+  NS_TEST_EXPECT_MSG_EQ_TOL (raster->CalcRxPower (14, gateway, outside),
+                             chain->CalcRxPower (14, gateway, outside), 1e-9,
+                             "Wrong downlink gain outside of the area");
+}
+
 /**************
  * Test Suite *
  **************/
@@ -1351,6 +1964,11 @@ LorawanTestSuite::LorawanTestSuite ()
   AddTestCase (new LogicalLoraChannelTest, TestCase::QUICK);
   AddTestCase (new TimeOnAirTest, TestCase::QUICK);
   AddTestCase (new PhyConnectivityTest, TestCase::QUICK);
+  AddTestCase (new RxParametersTest, TestCase::QUICK);
+  AddTestCase (new PacketTrackerTest, TestCase::QUICK);
+  AddTestCase (new BuildingPenetrationLossTest, TestCase::QUICK);
+  AddTestCase (new CorrelatedShadowingFieldTest, TestCase::QUICK);
+  AddTestCase (new RasterPropagationLossTest, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite